@@ -0,0 +1,103 @@
+#include "AllocCounter.h"
+
+#ifdef BATTLESHIP_COUNT_ALLOCS
+
+#include <cstdlib>
+#include <new>
+
+// Each thread only ever touches its own counter, so counting costs one
+// thread-local increment and never contends with the other game threads.
+static thread_local long long t_allocations = 0;
+
+bool allocationCountingEnabled()
+{
+    return true;
+}
+
+long long allocationCount()
+{
+    return t_allocations;
+}
+
+void* operator new(std::size_t size)
+{
+    t_allocations++;
+    if (size == 0)
+        size = 1;
+    void* p = std::malloc(size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    t_allocations++;
+    if (size == 0)
+        size = 1;
+    // aligned_alloc wants the size to be a multiple of the alignment
+    std::size_t a = static_cast<std::size_t>(align);
+    void* p = std::aligned_alloc(a, (size + a - 1) / a * a);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+// The array and nothrow forms of operator new forward to the ones above, but
+// every operator delete has to be replaced to match our use of malloc.
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#else
+
+bool allocationCountingEnabled()
+{
+    return false;
+}
+
+long long allocationCount()
+{
+    return 0;
+}
+
+#endif // BATTLESHIP_COUNT_ALLOCS
+
+/*
+#include "Game.h"
+#include "Player.h"
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier");
+    g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer");
+    g.addShip(3, 's', "submarine");
+    g.addShip(2, 'p', "patrol boat");
+    Player* p1 = createPlayer("good", "Charles", g);
+    Player* p2 = createPlayer("mediocre", "Mancy", g);
+    PlayOptions opts;
+    opts.quiet = true;
+    // Only the two boards are allocated, however many moves the game takes
+    AllocationScope scope;
+    g.play(p1, p2, opts);
+    assert(scope.allocations() == 2);
+    delete p1;
+    delete p2;
+}
+*/
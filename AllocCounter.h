@@ -0,0 +1,28 @@
+#ifndef ALLOCCOUNTER_INCLUDED
+#define ALLOCCOUNTER_INCLUDED
+
+// Heap allocation accounting. Build with BATTLESHIP_COUNT_ALLOCS defined and
+// AllocCounter.cpp replaces the global operator new/delete with versions that
+// count every allocation made by the calling thread. Without it the counter
+// always reads zero and allocationCountingEnabled() says so.
+
+bool allocationCountingEnabled();
+
+  // Number of heap allocations made so far by the calling thread
+long long allocationCount();
+
+  // Counts the allocations made by this thread while the object is alive, e.g.
+  //     AllocationScope scope;
+  //     ... play some moves ...
+  //     assert(scope.allocations() == 0);
+class AllocationScope
+{
+  public:
+    AllocationScope() : m_start(allocationCount()) {}
+    long long allocations() const { return allocationCount() - m_start; }
+
+  private:
+    long long m_start;
+};
+
+#endif // ALLOCCOUNTER_INCLUDED
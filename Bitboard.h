@@ -0,0 +1,96 @@
+#ifndef BITBOARD_INCLUDED
+#define BITBOARD_INCLUDED
+
+#include "globals.h"
+#include <cstdint>
+
+// A set of grid cells packed into two 64-bit words. Cell (r,c) lives at
+// bit r*MAXCOLS + c, so every board up to MAXROWS x MAXCOLS fits and the
+// set operations below are just a couple of word-wide instructions.
+class Bitboard
+{
+  public:
+    constexpr Bitboard() : m_lo(0), m_hi(0) {}
+    constexpr Bitboard(uint64_t lo, uint64_t hi) : m_lo(lo), m_hi(hi) {}
+
+    static constexpr int index(int r, int c) { return r * MAXCOLS + c; }
+    static constexpr Bitboard cell(int r, int c) { return bit(index(r, c)); }
+    static constexpr Bitboard bit(int i)
+    {
+        return i < 64 ? Bitboard(uint64_t(1) << i, 0)
+                      : Bitboard(0, uint64_t(1) << (i - 64));
+    }
+
+      // All the cells of a rows x cols board
+    static constexpr Bitboard full(int rows, int cols)
+    {
+        Bitboard b;
+        for (int r = 0; r < rows; r++)
+            for (int c = 0; c < cols; c++)
+                b = b | cell(r, c);
+        return b;
+    }
+
+    constexpr bool test(int r, int c) const { return testBit(index(r, c)); }
+    constexpr bool testBit(int i) const
+    {
+        return i < 64 ? (m_lo >> i) & 1 : (m_hi >> (i - 64)) & 1;
+    }
+    void set(int r, int c) { *this = *this | cell(r, c); }
+    void reset(int r, int c) { *this = andNot(cell(r, c)); }
+
+    constexpr bool empty() const { return (m_lo | m_hi) == 0; }
+    constexpr bool any() const { return !empty(); }
+    int count() const { return __builtin_popcountll(m_lo) + __builtin_popcountll(m_hi); }
+
+      // Index of the lowest set cell (the board must not be empty)
+    int first() const
+    {
+        return m_lo != 0 ? __builtin_ctzll(m_lo) : 64 + __builtin_ctzll(m_hi);
+    }
+      // Remove and return the lowest set cell (the board must not be empty)
+    int popFirst()
+    {
+        int i = first();
+        if (i < 64)
+            m_lo &= m_lo - 1;
+        else
+            m_hi &= m_hi - 1;
+        return i;
+    }
+
+    constexpr Bitboard andNot(Bitboard o) const { return Bitboard(m_lo & ~o.m_lo, m_hi & ~o.m_hi); }
+    constexpr bool intersects(Bitboard o) const { return ((m_lo & o.m_lo) | (m_hi & o.m_hi)) != 0; }
+    constexpr bool contains(Bitboard o) const { return o.andNot(*this).empty(); }
+
+    constexpr Bitboard operator|(Bitboard o) const { return Bitboard(m_lo | o.m_lo, m_hi | o.m_hi); }
+    constexpr Bitboard operator&(Bitboard o) const { return Bitboard(m_lo & o.m_lo, m_hi & o.m_hi); }
+    constexpr Bitboard operator^(Bitboard o) const { return Bitboard(m_lo ^ o.m_lo, m_hi ^ o.m_hi); }
+    Bitboard& operator|=(Bitboard o) { m_lo |= o.m_lo; m_hi |= o.m_hi; return *this; }
+    Bitboard& operator&=(Bitboard o) { m_lo &= o.m_lo; m_hi &= o.m_hi; return *this; }
+    constexpr bool operator==(Bitboard o) const { return m_lo == o.m_lo && m_hi == o.m_hi; }
+    constexpr bool operator!=(Bitboard o) const { return !(*this == o); }
+
+    constexpr uint64_t lo() const { return m_lo; }
+    constexpr uint64_t hi() const { return m_hi; }
+
+  private:
+    uint64_t m_lo;
+    uint64_t m_hi;
+};
+
+  // Cells covered by a ship of the given length starting at topOrLeft
+inline Bitboard shipCells(Point topOrLeft, int length, Direction dir)
+{
+    Bitboard b;
+    for (int k = 0; k < length; k++)
+    {
+        if (dir == HORIZONTAL)
+            b.set(topOrLeft.r, topOrLeft.c + k);
+        else
+            b.set(topOrLeft.r + k, topOrLeft.c);
+    }
+    return b;
+}
+
+#endif // BITBOARD_INCLUDED
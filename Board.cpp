@@ -1,6 +1,10 @@
 #include "Board.h"
 #include "Game.h"
 #include "globals.h"
+#include "Bitboard.h"
+#include "FixedBoard.h"
+#include "Trace.h"
+#include "PerfCounters.h"
 #include <iostream>
 
 using namespace std;
@@ -16,27 +20,38 @@ class BoardImpl
     bool unplaceShip(Point topOrLeft, int shipId, Direction dir);
     void display(bool shotsOnly) const;
     bool attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId);
+    int attackBatch(const Point* shots, int n, ShotResult* results);
     bool allShipsDestroyed() const;
 
   private:
     const Game& m_game;
     char m_grid[MAXROWS][MAXCOLS];
+    // Bit masks mirroring the grid so attacks don't have to rescan it
+    Bitboard m_shots;                       // every cell attacked so far
+    Bitboard m_afloat;                      // ship cells not yet hit
+    Bitboard m_shipAfloat[MAXSHIPS];        // the same, for each ship
+    signed char m_owner[MAXROWS][MAXCOLS];  // shipId in each cell, or -1
 };
 
 BoardImpl::BoardImpl(const Game& g)
  : m_game(g)
 {
-    for (int r = 0; r < m_game.rows(); r++)
-        for (int c = 0; c < m_game.cols(); c++)
-            m_grid[r][c] = '.';
+    clear();
 }
 
 void BoardImpl::clear()
 {
     // Goal: Iterate through the grid and set everythign to '.'
     for (int r = 0; r < m_game.rows(); r++)
-        for (int c = 0; c < m_game.cols(); c++)
+        for (int c = 0; c < m_game.cols(); c++){
             m_grid[r][c] = '.';
+            m_owner[r][c] = -1;
+        }
+    // No ships and no shots
+    m_shots = Bitboard();
+    m_afloat = Bitboard();
+    for (int s = 0; s < m_game.nShips(); s++)
+        m_shipAfloat[s] = Bitboard();
 }
 
 void BoardImpl::block()
@@ -68,12 +83,12 @@ void BoardImpl::unblock()
 bool BoardImpl::placeShip(Point topOrLeft, int shipId, Direction dir)
 {
     // Based on the properties of logShips as a vactor, if shipID is larger than the number of ships or it is less than 0 then it is not a valid ID in a vector and thus not valid as a ship
-    if (shipId > m_game.nShips() || shipId < 0)
+    if (shipId >= m_game.nShips() || shipId < 0)
         return false;
     // Ensure topOrLeft is in grid
     if (topOrLeft.r < 0 || topOrLeft.c < 0)
         return false;
-    if (topOrLeft.r > m_game.rows() || topOrLeft.c > m_game.cols())
+    if (topOrLeft.r >= m_game.rows() || topOrLeft.c >= m_game.cols())
         return false;
     // At this point the ship is valid and has a starting point in the grid
     
@@ -113,8 +128,13 @@ bool BoardImpl::placeShip(Point topOrLeft, int shipId, Direction dir)
     
     // At this point the ship passes all requirements -- so make the grid reflect the ship being there
     for (int r = topOrLeft.r; r <= endPoint.r; r++)
-        for (int c = topOrLeft.c; c <= endPoint.c; c++)
+        for (int c = topOrLeft.c; c <= endPoint.c; c++){
             m_grid[r][c] = m_game.shipSymbol(shipId);
+            m_owner[r][c] = shipId;
+        }
+    // And the masks
+    m_shipAfloat[shipId] = shipCells(topOrLeft, m_game.shipLength(shipId), dir);
+    m_afloat |= m_shipAfloat[shipId];
     
     return true;
 }
@@ -122,7 +142,7 @@ bool BoardImpl::placeShip(Point topOrLeft, int shipId, Direction dir)
 bool BoardImpl::unplaceShip(Point topOrLeft, int shipId, Direction dir)
 {
     // IF the shipId is invalid
-    if (shipId > m_game.nShips() || shipId < 0)
+    if (shipId >= m_game.nShips() || shipId < 0)
         return false;
     
     // Initialize an endpoint to refer to
@@ -144,8 +164,12 @@ bool BoardImpl::unplaceShip(Point topOrLeft, int shipId, Direction dir)
     
     // At this point the shipID is valid and the entire ship is at the indicated locations -- so 'remove' the ship and return true
     for (int r = topOrLeft.r; r <= endPoint.r; r++)
-        for (int c = topOrLeft.c; c <= endPoint.c; c++)
+        for (int c = topOrLeft.c; c <= endPoint.c; c++){
             m_grid[r][c] = '.';
+            m_owner[r][c] = -1;
+        }
+    m_afloat = m_afloat.andNot(m_shipAfloat[shipId]);
+    m_shipAfloat[shipId] = Bitboard();
     
     return true;
 }
@@ -195,28 +219,17 @@ bool BoardImpl::attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId)
     if (m_grid[p.r][p.c] == 'X' || m_grid[p.r][p.c] == 'o')
         return false;
     
-    // At this point it can't be 'X' or 'o' -- and if it's not '.' then it HAS TO be a ship
-    if (m_grid[p.r][p.c] != '.'){
-        int count = 0;
-        // Check to see if whole ship was destroyed
-        for (int r = 0; r < m_game.rows(); r++){
-            for (int c = 0; c < m_game.cols(); c++){
-                // If the character exists again then the whole ship is not destroyed
-                if (m_grid[r][c] == m_grid[p.r][p.c])
-                    count++;
-            }
-        }
-        
-        if (count == 1)
+    m_shots.set(p.r, p.c);
+    
+    // At this point it can't be 'X' or 'o' -- so it's a hit exactly when a ship cell is still afloat there
+    if (m_afloat.test(p.r, p.c)){
+        shipId = m_owner[p.r][p.c];
+        // The whole ship is destroyed once none of its cells are left afloat
+        m_shipAfloat[shipId].reset(p.r, p.c);
+        m_afloat.reset(p.r, p.c);
+        if (m_shipAfloat[shipId].empty())
             shipDestroyed = true;
         
-        for (int shipNum = 0; shipNum < m_game.nShips(); shipNum++){
-            if (m_grid[p.r][p.c] == m_game.shipSymbol(shipNum)){
-                shipId = shipNum;
-                break;
-            }
-        }
-        
         shotHit = true;
         m_grid[p.r][p.c] = 'X';
     }
@@ -229,73 +242,152 @@ bool BoardImpl::attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId)
     return true;
 }
 
+int BoardImpl::attackBatch(const Point* shots, int n, ShotResult* results)
+{
+    // Pass 1: validate every point against the shot mask and build the mask of this batch.
+    // A repeat within the batch is wasted just like a repeat of an earlier turn.
+    Bitboard batch;
+    int nValid = 0;
+    for (int i = 0; i < n; i++){
+        results[i].shipId = -1;
+        results[i].flags = 0;
+        Point p = shots[i];
+        if (p.r < 0 || p.c < 0 || p.r >= m_game.rows() || p.c >= m_game.cols())
+            continue;
+        if (m_shots.test(p.r, p.c) || batch.test(p.r, p.c))
+            continue;
+        batch.set(p.r, p.c);
+        results[i].flags = ShotResult::VALID;
+        nValid++;
+    }
+    
+    // Every hit of the batch in one go
+    Bitboard hits = batch & m_afloat;
+    m_shots |= batch;
+    m_afloat = m_afloat.andNot(batch);
+    
+    // Pass 2: only the hits need per-ship work. Go in order so the shot that finishes a ship is the one reported as destroying it
+    for (int i = 0; i < n; i++){
+        if (!(results[i].flags & ShotResult::VALID))
+            continue;
+        Point p = shots[i];
+        if (!hits.test(p.r, p.c)){
+            m_grid[p.r][p.c] = 'o';
+            continue;
+        }
+        int id = m_owner[p.r][p.c];
+        m_shipAfloat[id].reset(p.r, p.c);
+        results[i].shipId = id;
+        results[i].flags |= ShotResult::HIT;
+        if (m_shipAfloat[id].empty())
+            results[i].flags |= ShotResult::DESTROYED;
+        m_grid[p.r][p.c] = 'X';
+    }
+    return nValid;
+}
+
 bool BoardImpl::allShipsDestroyed() const
 {
-    // If there remains no ship characters then they are all destroyed
-    for (int r = 0; r < m_game.rows(); r++)
-        for (int c = 0; c < m_game.cols(); c++)
-            // IF it doesn't equal these three then it must be a ship char
-            if (m_grid[r][c] != '.' && m_grid[r][c] != 'X' && m_grid[r][c] != 'o')
-                // Not all ships are destroyed if there reamins a ship character
-                return false;
-    // If it makes it to this point then they are all destroyed
-    return true;
+    // If no ship cell remains afloat then they are all destroyed
+    return m_afloat.empty();
 }
 
 
 
 //******************** Board functions ********************************
 
-// These functions simply delegate to BoardImpl's functions.
+// These functions simply delegate to StandardBoard's or BoardImpl's functions.
 // You probably don't want to change any of this code.
 
 Board::Board(const Game& g)
+ : m_fixed(nullptr), m_impl(nullptr)
 {
+#ifndef BATTLESHIP_NO_FIXED_BOARD
+    if (StandardBoard::fits(g)){
+        m_fixed = new StandardBoard(g);
+        return;
+    }
+#endif
     m_impl = new BoardImpl(g);
 }
 
 Board::~Board()
 {
+    delete m_fixed;
     delete m_impl;
 }
 
 void Board::clear()
 {
-    m_impl->clear();
+    PERF_SCOPE("Board::clear", "board");
+    if (m_fixed != nullptr)
+        m_fixed->clear();
+    else
+        m_impl->clear();
 }
 
 void Board::block()
 {
+    PERF_SCOPE("Board::block", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->block();
     return m_impl->block();
 }
 
 void Board::unblock()
 {
+    PERF_SCOPE("Board::unblock", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->unblock();
     return m_impl->unblock();
 }
 
 bool Board::placeShip(Point topOrLeft, int shipId, Direction dir)
 {
+    PERF_SCOPE("Board::placeShip", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->placeShip(topOrLeft, shipId, dir);
     return m_impl->placeShip(topOrLeft, shipId, dir);
 }
 
 bool Board::unplaceShip(Point topOrLeft, int shipId, Direction dir)
 {
+    PERF_SCOPE("Board::unplaceShip", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->unplaceShip(topOrLeft, shipId, dir);
     return m_impl->unplaceShip(topOrLeft, shipId, dir);
 }
 
 void Board::display(bool shotsOnly) const
 {
-    m_impl->display(shotsOnly);
+    if (m_fixed != nullptr)
+        m_fixed->display(shotsOnly);
+    else
+        m_impl->display(shotsOnly);
 }
 
 bool Board::attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId)
 {
+    TRACE_SCOPE("Board::attack", "board");
+    PERF_SCOPE("Board::attack", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->attack(p, shotHit, shipDestroyed, shipId);
     return m_impl->attack(p, shotHit, shipDestroyed, shipId);
 }
 
+int Board::attackBatch(const Point* shots, int n, ShotResult* results)
+{
+    TRACE_SCOPE("Board::attackBatch", "board");
+    PERF_SCOPE("Board::attackBatch", "board");
+    if (m_fixed != nullptr)
+        return m_fixed->attackBatch(shots, n, results);
+    return m_impl->attackBatch(shots, n, results);
+}
+
 bool Board::allShipsDestroyed() const
 {
+    if (m_fixed != nullptr)
+        return m_fixed->allShipsDestroyed();
     return m_impl->allShipsDestroyed();
 }
 
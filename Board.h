@@ -5,6 +5,15 @@
 
 class Game;
 class BoardImpl;
+class StandardBoard;
+
+  // One entry of the compact result array filled by Board::attackBatch
+struct ShotResult
+{
+    enum { VALID = 1, HIT = 2, DESTROYED = 4 };
+    signed char shipId;     // -1 unless the shot hit a ship
+    unsigned char flags;    // combination of VALID, HIT, DESTROYED
+};
 
 class Board
 {
@@ -18,12 +27,16 @@ class Board
     bool unplaceShip(Point topOrLeft, int shipId, Direction dir);
     void display(bool shotsOnly) const;
     bool attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId);
+    int attackBatch(const Point* shots, int n, ShotResult* results);
     bool allShipsDestroyed() const;
       // We prevent a Board object from being copied or assigned
     Board(const Board&) = delete;
     Board& operator=(const Board&) = delete;
 
   private:
+    // Exactly one of these is set: the compile-time board for the standard
+    // game (see FixedBoard.h) or the general one
+    StandardBoard* m_fixed;
     BoardImpl* m_impl;
 };
 
@@ -0,0 +1,348 @@
+#include "Configurations.h"
+#include "Knowledge.h"
+#include "Game.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t DEFAULT_LIMIT = 500000;
+
+struct State
+{
+    Bitboard key;                // taken cells the ships still to come could use
+    unsigned long long ways;     // to get here
+    unsigned long long rest;     // to finish from here
+};
+
+// Keys to counts, open addressing: a layer is filled once and then only
+// looked up, and this is where the time goes
+class Tally
+{
+  public:
+    Tally() : m_size(0), m_mask(0) {}
+    size_t size() const { return m_size; }
+      // The count for key, starting at 0 if it's new
+    unsigned long long& operator[](Bitboard key)
+    {
+        if (2 * (m_size + 1) > m_slots.size())
+            grow();
+        size_t i = slot(key);
+        if (!m_slots[i].used){
+            m_slots[i].used = true;
+            m_slots[i].key = key;
+            m_slots[i].count = 0;
+            m_size++;
+        }
+        return m_slots[i].count;
+    }
+      // The count for key, or 0 if it isn't there
+    unsigned long long at(Bitboard key) const
+    {
+        if (m_slots.empty())
+            return 0;
+        const Slot& sl = m_slots[slot(key)];
+        return sl.used ? sl.count : 0;
+    }
+      // Every key with its count, in no particular order
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+            if (m_slots[i].used)
+                f(m_slots[i].key, m_slots[i].count);
+    }
+    void clear()
+    {
+        std::vector<Slot>().swap(m_slots);
+        m_size = 0;
+        m_mask = 0;
+    }
+
+  private:
+    struct Slot
+    {
+        Bitboard key;
+        unsigned long long count;
+        bool used;
+    };
+
+    size_t slot(Bitboard key) const
+    {
+        uint64_t h = key.lo() * 0x9E3779B97F4A7C15ULL ^ (key.hi() + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+        size_t i = size_t(h ^ (h >> 31)) & m_mask;
+        while (m_slots[i].used && m_slots[i].key != key)
+            i = (i + 1) & m_mask;
+        return i;
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old;
+        old.swap(m_slots);
+        m_slots.resize(old.empty() ? 64 : 2 * old.size());
+        m_mask = m_slots.size() - 1;
+        for (size_t i = 0; i < old.size(); i++)
+            if (old[i].used)
+                m_slots[slot(old[i].key)] = old[i];
+    }
+
+    std::vector<Slot> m_slots;
+    size_t m_size;
+    size_t m_mask;
+};
+
+// Runs f(t, begin, end) on slice t of [0, n), one slice per thread; a
+// layer too small to be worth the threads is done in one slice
+template <typename F>
+void split(int threads, size_t n, F f)
+{
+    if (n < 64 * (size_t)threads)
+        threads = 1;
+    vector<thread> helpers;
+    for (int t = 1; t < threads; t++)
+        helpers.push_back(thread(f, t, n * t / threads, n * (t + 1) / threads));
+    f(0, 0, n / threads);
+    for (size_t t = 0; t < helpers.size(); t++)
+        helpers[t].join();
+}
+
+bool add(unsigned long long& total, unsigned long long n)
+{
+    return !__builtin_add_overflow(total, n, &total);
+}
+
+} // namespace
+
+ConfigurationCounter::ConfigurationCounter(const Game& g)
+ : m_game(g), m_limit(DEFAULT_LIMIT), m_states(0), m_total(0)
+{
+    fill(m_occupied, m_occupied + MAXROWS * MAXCOLS, 0ULL);
+}
+
+double ConfigurationCounter::probability(Point p) const
+{
+    if (m_total == 0)
+        return 0;
+    return (double)occupied(p) / m_total;
+}
+
+bool ConfigurationCounter::count(const Knowledge& k, int threads)
+{
+    m_total = 0;
+    m_states = 0;
+    fill(m_occupied, m_occupied + MAXROWS * MAXCOLS, 0ULL);
+    if (threads < 1)
+        threads = 1;
+    int n = m_game.nShips();
+
+    // The ships' possible placements, the most hemmed in ship first so the
+    // early layers stay small
+    vector<vector<Bitboard> > live(n);
+    vector<int> order;
+    for (int s = 0; s < n; s++){
+        for (int j = 0; j < k.nPlacements(s); j++)
+            if (k.possible(s, j))
+                live[s].push_back(k.placement(s, j));
+        order.push_back(s);
+    }
+    sort(order.begin(), order.end(), [&live](int a, int b){ return live[a].size() < live[b].size(); });
+
+    // reach[d]: every cell the ships from the d-th on could be on
+    vector<Bitboard> reach(n + 1);
+    for (int d = n - 1; d >= 0; d--){
+        reach[d] = reach[d + 1];
+        for (size_t j = 0; j < live[order[d]].size(); j++)
+            reach[d] |= live[order[d]][j];
+    }
+    // Every hit has to end up under a ship: those the d-th ship is the last
+    // chance for have to be covered once it's down
+    Bitboard hits = k.hits();
+    if (!reach[0].contains(hits))
+        return true;    // nothing fits
+    vector<Bitboard> due(n);
+    for (int d = 0; d < n; d++)
+        due[d] = (hits & reach[d]).andNot(reach[d + 1]);
+
+    vector<vector<State> > layers(n + 1);
+    vector<Tally> index(n + 1);     // by key, where it is in its layer
+    State start = { Bitboard(), 1, 0 };
+    layers[0].push_back(start);
+    vector<char> failed(threads);
+
+    // Forward: the ways to reach each key
+    for (int d = 0; d < n; d++){
+        const vector<Bitboard>& options = live[order[d]];
+        const vector<State>& from = layers[d];
+        Bitboard ahead = reach[d + 1];
+        vector<Tally> tallies(threads);
+        split(threads, from.size(), [&](int t, size_t begin, size_t end){
+            Tally& tally = tallies[t];
+            for (size_t i = begin; i < end && !failed[t]; i++){
+                Bitboard key = from[i].key;
+                for (size_t j = 0; j < options.size(); j++){
+                    if (options[j].intersects(key))
+                        continue;
+                    Bitboard taken = key | options[j];
+                    if (!taken.contains(due[d]))
+                        continue;
+                    if (!add(tally[taken & ahead], from[i].ways))
+                        failed[t] = 1;
+                }
+                if (tally.size() > m_limit)
+                    failed[t] = 1;
+            }
+        });
+        Tally& merged = tallies[0];
+        for (int t = 1; t < threads; t++){
+            tallies[t].forEach([&](Bitboard key, unsigned long long ways){
+                if (!add(merged[key], ways))
+                    failed[0] = 1;
+            });
+            tallies[t].clear();
+        }
+        if (find(failed.begin(), failed.end(), 1) != failed.end() || merged.size() > m_limit)
+            return false;
+
+        vector<State>& to = layers[d + 1];
+        to.reserve(merged.size());
+        merged.forEach([&](Bitboard key, unsigned long long ways){
+            State st = { key, ways, 0 };
+            index[d + 1][key] = to.size();
+            to.push_back(st);
+        });
+        m_states += to.size();
+    }
+    // Nothing's left to cover after the last ship, so every key there is empty
+    if (layers[n].empty())
+        return true;
+    layers[n][0].rest = 1;
+
+    // Back: the ways to finish from each key, and the fleets through each
+    // placement on the way
+    vector<vector<unsigned long long> > occupied(threads, vector<unsigned long long>(MAXROWS * MAXCOLS));
+    for (int d = n - 1; d >= 0; d--){
+        const vector<Bitboard>& options = live[order[d]];
+        vector<State>& at = layers[d];
+        const vector<State>& next = layers[d + 1];
+        const Tally& where = index[d + 1];
+        Bitboard ahead = reach[d + 1];
+        split(threads, at.size(), [&](int t, size_t begin, size_t end){
+            unsigned long long* occ = &occupied[t][0];
+            for (size_t i = begin; i < end && !failed[t]; i++){
+                Bitboard key = at[i].key;
+                unsigned long long rest = 0;
+                for (size_t j = 0; j < options.size(); j++){
+                    if (options[j].intersects(key))
+                        continue;
+                    Bitboard taken = key | options[j];
+                    if (!taken.contains(due[d]))
+                        continue;
+                    unsigned long long after = next[where.at(taken & ahead)].rest;
+                    if (after == 0)
+                        continue;
+                    unsigned long long fleets;
+                    if (!add(rest, after) || __builtin_mul_overflow(at[i].ways, after, &fleets)){
+                        failed[t] = 1;
+                        break;
+                    }
+                    for (Bitboard b = options[j]; b.any(); )
+                        if (!add(occ[b.popFirst()], fleets))
+                            failed[t] = 1;
+                }
+                at[i].rest = rest;
+            }
+        });
+        if (find(failed.begin(), failed.end(), 1) != failed.end())
+            return false;
+        vector<State>().swap(layers[d + 1]);
+        index[d + 1].clear();
+    }
+
+    // No cell is under more fleets than there are, so these can't overflow
+    m_total = layers[0][0].rest;
+    for (int t = 0; t < threads; t++)
+        for (int i = 0; i < MAXROWS * MAXCOLS; i++)
+            m_occupied[i] += occupied[t][i];
+    return true;
+}
+
+// Exact odds against sampled ones, a few times through a game: fleets drawn
+// from what Knowledge allows, for as long as the exact count took
+/*
+#include "PlacementSampler.h"
+#include "Player.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    PlacementSampler sampler(g);
+    PlacementSampler::Placement fleet[MAXSHIPS];
+    sampler.sample(fleet);
+    vector<Bitboard> afloat;
+    for (int s = 0; s < g.nShips(); s++)
+        afloat.push_back(shipCells(fleet[s].topOrLeft, g.shipLength(s), fleet[s].dir));
+    Knowledge k(g);
+    ConfigurationCounter counter(g);
+    Player* shooter = createPlayer("good", "shooter", g);
+    for (int shot = 0; shot <= 40; shot++){
+        if (shot % 5 == 0){
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bool counted = counter.count(k);
+            double took = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (!counted){
+                cout << shot << " shots: gave up after " << took * 1000 << " ms" << endl;
+            } else {
+                vector<vector<Bitboard> > live(g.nShips());
+                for (int s = 0; s < g.nShips(); s++)
+                    for (int j = 0; j < k.nPlacements(s); j++)
+                        if (k.possible(s, j))
+                            live[s].push_back(k.placement(s, j));
+                double seen[MAXROWS * MAXCOLS] = {};
+                long long kept = 0;
+                start = chrono::steady_clock::now();
+                while (chrono::duration<double>(chrono::steady_clock::now() - start).count() < max(took, 0.001)){
+                    Bitboard all;
+                    bool fits = true;
+                    for (int s = 0; s < g.nShips() && fits; s++){
+                        Bitboard b = live[s][randInt((int)live[s].size())];
+                        fits = !b.intersects(all);
+                        all |= b;
+                    }
+                    if (!fits || !all.contains(k.hits()))
+                        continue;
+                    kept++;
+                    while (all.any())
+                        seen[all.popFirst()]++;
+                }
+                double worst = 0;
+                for (int r = 0; r < g.rows(); r++)
+                    for (int c = 0; c < g.cols(); c++)
+                        worst = max(worst, fabs(counter.probability(Point(r, c)) - seen[Bitboard::index(r, c)] / kept));
+                cout << shot << " shots: " << counter.configurations() << " fleets in " << took * 1000
+                     << " ms; sampling's worst cell is off by " << worst << endl;
+            }
+        }
+        Point p = shooter->recommendAttack();
+        int i = Bitboard::index(p.r, p.c);
+        bool hit = false, sunk = false;
+        int id = -1;
+        for (int s = 0; s < g.nShips(); s++)
+            if (afloat[s].testBit(i)){
+                afloat[s] = afloat[s].andNot(Bitboard::bit(i));
+                hit = true;
+                sunk = afloat[s].empty();
+                id = sunk ? s : -1;
+            }
+        shooter->recordAttackResult(p, true, hit, sunk, id);
+        k.record(p, hit, sunk, id);
+    }
+    delete shooter;
+}
+*/
@@ -0,0 +1,53 @@
+#ifndef CONFIGURATIONS_INCLUDED
+#define CONFIGURATIONS_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include <cstddef>
+
+class Game;
+class Knowledge;
+
+// Counts, exactly, the ways the opponent's whole fleet can lie given what a
+// Knowledge has seen, and how many of them put a ship on each cell -- the
+// true odds that Knowledge's per-placement counts and sampled fleets only
+// approximate.
+//
+// The ships go down one at a time, each only where Knowledge still allows
+// it. After some of them are placed, all that matters for the rest is which
+// of the cells the rest could use are taken, so fleets that agree there are
+// counted together: a layer per ship, keyed on those cells. A pass forward
+// counts the ways to reach each key, a pass back the ways to finish from it,
+// and the product of the two over every placement through a cell is how
+// many fleets have a ship there. Each layer is split among the threads.
+//
+// Early in a game there are too many keys to be worth it; count gives up
+// past a limit (and if a count won't fit in 64 bits) rather than run on.
+
+class ConfigurationCounter
+{
+  public:
+    ConfigurationCounter(const Game& g);
+      // Counts for what k has seen; false if it gave up, leaving no counts
+    bool count(const Knowledge& k, int threads = 1);
+      // The results of the last count; all zero if it gave up
+    unsigned long long configurations() const { return m_total; }
+    unsigned long long occupied(Point p) const { return m_occupied[Bitboard::index(p.r, p.c)]; }
+    double probability(Point p) const;
+      // How many keys the last count went through
+    std::size_t states() const { return m_states; }
+      // The most keys a layer may have before count gives up
+    void setStateLimit(std::size_t n) { m_limit = n; }
+      // We prevent a ConfigurationCounter object from being copied or assigned
+    ConfigurationCounter(const ConfigurationCounter&) = delete;
+    ConfigurationCounter& operator=(const ConfigurationCounter&) = delete;
+
+  private:
+    const Game& m_game;
+    std::size_t m_limit;
+    std::size_t m_states;
+    unsigned long long m_total;
+    unsigned long long m_occupied[MAXROWS * MAXCOLS];
+};
+
+#endif // CONFIGURATIONS_INCLUDED
@@ -0,0 +1,384 @@
+#include "Dataset.h"
+#include "Game.h"
+#include "Board.h"
+#include "Endian.h"
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[4] = { 'B', 'S', 'D', 'S' };
+const char INDEX_MAGIC[8] = { 'B', 'S', 'D', 'X', 0, 0, 0, 0 };
+const uint32_t VERSION = 1;
+
+// PackBits: a header byte h < 128 is followed by h+1 bytes to copy; h > 128
+// is followed by one byte to repeat 257-h times
+void packBits(const uint8_t* in, size_t n, vector<uint8_t>& out)
+{
+    size_t i = 0;
+    while (i < n){
+        size_t run = 1;
+        while (i + run < n && run < 128 && in[i + run] == in[i])
+            run++;
+        if (run >= 3){
+            out.push_back((uint8_t)(257 - run));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+        // Copy bytes over as they are up to the next run worth packing
+        size_t start = i;
+        while (i < n && i - start < 128){
+            if (i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2])
+                break;
+            i++;
+        }
+        out.push_back((uint8_t)(i - start - 1));
+        out.insert(out.end(), in + start, in + i);
+    }
+}
+
+bool unpackBits(const uint8_t* in, size_t n, uint8_t* out, size_t outSize)
+{
+    size_t i = 0, o = 0;
+    while (i < n){
+        uint8_t h = in[i++];
+        if (h < 128){
+            size_t len = h + 1;
+            if (i + len > n || o + len > outSize)
+                return false;
+            memcpy(out + o, in + i, len);
+            i += len;
+            o += len;
+        }
+        else if (h > 128){
+            size_t len = 257 - h;
+            if (i >= n || o + len > outSize)
+                return false;
+            memset(out + o, in[i++], len);
+            o += len;
+        }
+    }
+    return o == outSize;
+}
+
+} // namespace
+
+//*********************************************************************
+//  DatasetWriter
+//*********************************************************************
+
+DatasetWriter::DatasetWriter(const Game& g, const string& path, int chunkRows)
+ : m_game(g), m_nCells(g.rows() * g.cols()), m_out(path.c_str(), ios::binary), m_closed(false),
+   m_chunkRows(chunkRows < 8 ? 8 : chunkRows), m_rows(0), m_rowsWritten(0)
+{
+    m_cellColumns.resize(m_nCells, vector<uint8_t>((m_chunkRows + 3) / 4));
+    m_chosenColumn.resize(m_chunkRows);
+    m_wonColumn.resize((m_chunkRows + 7) / 8);
+    m_out.write(MAGIC, 4);
+    writeLE(m_out, VERSION, 4);
+    writeLE(m_out, g.rows(), 4);
+    writeLE(m_out, g.cols(), 4);
+}
+
+DatasetWriter::~DatasetWriter()
+{
+    if (!m_closed)
+        close();
+    for (size_t k = 0; k < m_games.size(); k++)
+        delete m_games[k];
+}
+
+void DatasetWriter::write(const GameEvent* events, int n)
+{
+    for (int k = 0; k < n; k++)
+        event(events[k]);
+}
+
+void DatasetWriter::event(const GameEvent& e)
+{
+    if (e.producer >= m_games.size())
+        m_games.resize(e.producer + 1, nullptr);
+    InGame*& g = m_games[e.producer];
+    if (g == nullptr)
+        g = new InGame;
+
+    if (e.kind == GameEvent::START){
+        g->game = e.game;
+        memset(g->seen, UNKNOWN, sizeof(g->seen));
+        g->states.clear();
+        g->chosen.clear();
+        g->seat.clear();
+        return;
+    }
+    if (e.game != g->game)
+        return;
+
+    if (e.kind == GameEvent::END){
+        // Now we know how each shot turned out
+        for (size_t k = 0; k < g->chosen.size(); k++)
+            addRow(&g->states[k * m_nCells], g->chosen[k], g->seat[k] == e.seat);
+        g->states.clear();
+        g->chosen.clear();
+        g->seat.clear();
+        return;
+    }
+
+    // Wasted shots say nothing about the board
+    if ((e.flags & ShotResult::VALID) == 0 || e.seat > 1)
+        return;
+    uint8_t* seen = g->seen[e.seat];
+    int cell = e.r * m_game.cols() + e.c;
+    g->states.insert(g->states.end(), seen, seen + m_nCells);
+    g->chosen.push_back((uint8_t)cell);
+    g->seat.push_back(e.seat);
+
+    if ((e.flags & ShotResult::HIT) == 0)
+        seen[cell] = MISS;
+    else{
+        seen[cell] = HIT;
+        if ((e.flags & ShotResult::DESTROYED) != 0 && e.shipId >= 0 && e.shipId < m_game.nShips())
+            markSunk(seen, m_game.rows(), m_game.cols(), e.r, e.c, m_game.shipLength(e.shipId));
+    }
+}
+
+void markSunk(uint8_t* seen, int rows, int cols, int r, int c, int length)
+{
+    // How far the unexplained hits run from (r,c) in each direction
+    int left = c, right = c, up = r, down = r;
+    while (left > 0 && seen[r * cols + left - 1] == HIT)
+        left--;
+    while (right < cols - 1 && seen[r * cols + right + 1] == HIT)
+        right++;
+    while (up > 0 && seen[(up - 1) * cols + c] == HIT)
+        up--;
+    while (down < rows - 1 && seen[(down + 1) * cols + c] == HIT)
+        down++;
+    bool across = right - left + 1 == length;
+    bool downward = down - up + 1 == length;
+    // Only a run of exactly the ship's length, in only one direction, says where it was
+    if (across && down - up + 1 < length)
+        for (int k = left; k <= right; k++)
+            seen[r * cols + k] = SUNK;
+    else if (downward && right - left + 1 < length)
+        for (int k = up; k <= down; k++)
+            seen[k * cols + c] = SUNK;
+    else
+        seen[r * cols + c] = SUNK;
+}
+
+void DatasetWriter::addRow(const uint8_t* state, int cell, bool won)
+{
+    int i = m_rows;
+    int shift = 2 * (i % 4);
+    for (int k = 0; k < m_nCells; k++)
+        m_cellColumns[k][i / 4] |= state[k] << shift;
+    m_chosenColumn[i] = (uint8_t)cell;
+    if (won)
+        m_wonColumn[i / 8] |= 1 << (i % 8);
+    if (++m_rows == m_chunkRows)
+        writeChunk();
+}
+
+void DatasetWriter::writeChunk()
+{
+    if (m_rows == 0)
+        return;
+    m_chunkOffsets.push_back((uint64_t)m_out.tellp());
+
+    // Compress every column, then write their sizes followed by the data
+    vector<const uint8_t*> columns;
+    vector<size_t> rawSizes;
+    for (int k = 0; k < m_nCells; k++){
+        columns.push_back(&m_cellColumns[k][0]);
+        rawSizes.push_back((m_rows + 3) / 4);
+    }
+    columns.push_back(&m_chosenColumn[0]);
+    rawSizes.push_back(m_rows);
+    columns.push_back(&m_wonColumn[0]);
+    rawSizes.push_back((m_rows + 7) / 8);
+
+    vector<uint8_t> packed;
+    vector<size_t> packedSizes;
+    for (size_t k = 0; k < columns.size(); k++){
+        size_t before = packed.size();
+        packBits(columns[k], rawSizes[k], packed);
+        packedSizes.push_back(packed.size() - before);
+    }
+    writeLE(m_out, m_rows, 4);
+    writeLE(m_out, (uint32_t)columns.size(), 4);
+    for (size_t k = 0; k < columns.size(); k++){
+        writeLE(m_out, (uint32_t)rawSizes[k], 4);
+        writeLE(m_out, (uint32_t)packedSizes[k], 4);
+    }
+    m_out.write((const char*)&packed[0], packed.size());
+
+    m_rowsWritten += m_rows;
+    m_rows = 0;
+    for (int k = 0; k < m_nCells; k++)
+        fill(m_cellColumns[k].begin(), m_cellColumns[k].end(), 0);
+    fill(m_wonColumn.begin(), m_wonColumn.end(), 0);
+}
+
+bool DatasetWriter::close()
+{
+    if (m_closed)
+        return bool(m_out);
+    m_closed = true;
+    writeChunk();
+    // The index: where each chunk starts, how many there are, and how many rows in all
+    for (size_t k = 0; k < m_chunkOffsets.size(); k++)
+        writeLE(m_out, m_chunkOffsets[k], 8);
+    writeLE(m_out, m_chunkOffsets.size(), 8);
+    writeLE(m_out, m_rowsWritten, 8);
+    m_out.write(INDEX_MAGIC, 8);
+    m_out.close();
+    return bool(m_out);
+}
+
+//*********************************************************************
+//  DatasetReader
+//*********************************************************************
+
+DatasetReader::DatasetReader(const string& path)
+ : m_data(nullptr), m_size(0), m_rows(0), m_cols(0), m_totalRows(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= 16 + 24)
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return;
+    const uint8_t* data = (const uint8_t*)p;
+    size_t size = st.st_size;
+
+    // Check both ends before trusting anything in between
+    const uint8_t* footer = data + size - 24;
+    uint64_t n = loadLE(footer, 8);
+    uint32_t rows = (uint32_t)loadLE(data + 8, 4), cols = (uint32_t)loadLE(data + 12, 4);
+    if (memcmp(data, MAGIC, 4) != 0 || loadLE(data + 4, 4) != VERSION ||
+            memcmp(footer + 16, INDEX_MAGIC, 8) != 0 || n > (size - 16 - 24) / 8 ||
+            rows < 1 || rows > MAXROWS || cols < 1 || cols > MAXCOLS){
+        munmap(p, size);
+        return;
+    }
+    m_data = data;
+    m_size = size;
+    m_rows = (int)rows;
+    m_cols = (int)cols;
+    m_totalRows = loadLE(footer + 8, 8);
+    for (uint64_t k = 0; k < n; k++)
+        m_chunkOffsets.push_back(loadLE(footer - 8 * n + 8 * k, 8));
+}
+
+DatasetReader::~DatasetReader()
+{
+    if (m_data != nullptr)
+        munmap((void*)m_data, m_size);
+}
+
+int DatasetReader::loadChunk(int k)
+{
+    if (m_data == nullptr || k < 0 || k >= nChunks())
+        return -1;
+    uint64_t off = m_chunkOffsets[k];
+    int nCells = m_rows * m_cols;
+    size_t nColumns = nCells + 2;
+    if (off > m_size || 8 + 8 * nColumns > m_size - off)
+        return -1;
+    const uint8_t* p = m_data + off;
+    uint32_t nRows = (uint32_t)loadLE(p, 4);
+    if (nRows > INT_MAX || loadLE(p + 4, 4) != nColumns)
+        return -1;
+    const uint8_t* sizes = p + 8;
+    const uint8_t* packed = sizes + 8 * nColumns;
+
+    m_cellColumns.resize(nCells);
+    for (size_t c = 0; c < nColumns; c++){
+        size_t raw = loadLE(sizes + 8 * c, 4);
+        size_t len = loadLE(sizes + 8 * c + 4, 4);
+        if (len > (size_t)(m_data + m_size - packed))
+            return -1;
+        // Enough for every row: four cells to a byte, a byte per chosen
+        // cell, eight results to a byte
+        size_t needed = c < (size_t)nCells ? (nRows + 3) / 4 :
+                        c == (size_t)nCells ? nRows : (nRows + 7) / 8;
+        if (raw < needed)
+            return -1;
+        vector<uint8_t>& column = c < (size_t)nCells ? m_cellColumns[c] :
+                                  c == (size_t)nCells ? m_chosenColumn : m_wonColumn;
+        column.resize(raw);
+        if (!unpackBits(packed, len, column.data(), raw))
+            return -1;
+        packed += len;
+    }
+    for (uint32_t row = 0; row < nRows; row++)
+        if (m_chosenColumn[row] >= nCells)
+            return -1;
+    return (int)nRows;
+}
+
+CellKnowledge DatasetReader::state(int row, int r, int c) const
+{
+    return (CellKnowledge)((m_cellColumns[r * m_cols + c][row / 4] >> (2 * (row % 4))) & 3);
+}
+
+Point DatasetReader::chosen(int row) const
+{
+    return Point(m_chosenColumn[row] / m_cols, m_chosenColumn[row] % m_cols);
+}
+
+bool DatasetReader::won(int row) const
+{
+    return (m_wonColumn[row / 8] >> (row % 8)) & 1;
+}
+
+// Self-play straight into a dataset, then a look at what came out
+/*
+#include "Player.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    {
+        DatasetWriter data(g, "selfplay.bsds");
+        {
+            LogWriter w(data);
+            Player* p1 = createPlayer("good", "g1", g);
+            Player* p2 = createPlayer("mediocre", "m2", g);
+            Board b1(g), b2(g);
+            PlayOptions opts;
+            opts.quiet = true;
+            opts.log = w.producer();
+            for (int k = 0; k < 10000; k++)
+                g.play(p1, p2, b1, b2, opts);
+            delete p1;
+            delete p2;
+        }   // the LogWriter has to be finished before the dataset is closed
+        data.close();
+    }
+    DatasetReader in("selfplay.bsds");
+    cout << in.totalRows() << " rows in " << in.nChunks() << " chunks" << endl;
+    int n = in.loadChunk(0);
+    for (int row = 0; row < n && row < 3; row++){
+        for (int r = 0; r < in.rows(); r++){
+            for (int c = 0; c < in.cols(); c++)
+                cout << ".ox#"[in.state(row, r, c)];
+            cout << endl;
+        }
+        cout << "fires at (" << in.chosen(row).r << "," << in.chosen(row).c << ")"
+             << (in.won(row) ? " and wins" : " and loses") << endl;
+    }
+}
+*/
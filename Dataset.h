@@ -0,0 +1,117 @@
+#ifndef DATASET_INCLUDED
+#define DATASET_INCLUDED
+
+#include "globals.h"
+#include "GameLog.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Game;
+
+// Training data from self-play. Each row is one shot: what the shooter knew
+// about the opponent's board just before it (every cell unknown, a miss, a
+// hit, or part of a sunk ship), the cell it chose, and whether it went on to
+// win the game.
+//
+// A DatasetWriter is an EventSink, so it sits behind a LogWriter and builds
+// rows from the game events as the games are played (see GameLog.h). What a
+// player knows is rebuilt the way a player would: from the results of its own
+// shots. A sunk notice says which ship went down but not where it lay, so the
+// cells are only marked sunk when the hits around the sinking shot pin the
+// ship down; otherwise just the sinking shot's cell is.
+//
+// The file holds the rows in chunks. Inside a chunk the data is columnar --
+// one column per cell with 2 bits per row, one column of chosen cells, one of
+// outcomes with 1 bit per row -- and each column is run-length compressed,
+// which works well because a cell stays the same for long stretches of rows.
+// An index of the chunks at the end of the file lets a DatasetReader map the
+// file into memory and go straight to any chunk.
+
+enum CellKnowledge { UNKNOWN, MISS, HIT, SUNK };
+
+  // Marks the ship that just sank with a shot at (r,c) in seen, a
+  // CellKnowledge for each cell r * cols + c, the way the rows get them
+void markSunk(uint8_t* seen, int rows, int cols, int r, int c, int length);
+
+class DatasetWriter : public EventSink
+{
+  public:
+    DatasetWriter(const Game& g, const std::string& path, int chunkRows = 1 << 16);
+      // Calls close if that hasn't been done
+    ~DatasetWriter();
+    bool ok() const { return bool(m_out); }
+    virtual void write(const GameEvent* events, int n);
+      // Writes the last chunk and the index; returns false if anything failed
+    bool close();
+    long long rowsWritten() const { return m_rowsWritten; }
+      // We prevent a DatasetWriter object from being copied or assigned
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+
+  private:
+      // The game a producer is in the middle of
+    struct InGame
+    {
+        uint32_t game;
+        uint8_t seen[2][MAXROWS * MAXCOLS];   // each seat's knowledge, a CellKnowledge per cell
+        std::vector<uint8_t> states;          // pending rows: a copy of seen[seat] each,
+        std::vector<uint8_t> chosen;          //   the cell fired at
+        std::vector<uint8_t> seat;            //   and who fired
+    };
+
+    void event(const GameEvent& e);
+    void addRow(const uint8_t* state, int cell, bool won);
+    void writeChunk();
+
+    const Game& m_game;
+    int m_nCells;
+    std::ofstream m_out;
+    bool m_closed;
+    int m_chunkRows;
+    std::vector<InGame*> m_games;    // by producer
+      // The chunk being filled
+    int m_rows;
+    std::vector<std::vector<uint8_t> > m_cellColumns;
+    std::vector<uint8_t> m_chosenColumn;
+    std::vector<uint8_t> m_wonColumn;
+    std::vector<uint64_t> m_chunkOffsets;
+    long long m_rowsWritten;
+};
+
+class DatasetReader
+{
+  public:
+    DatasetReader(const std::string& path);
+    ~DatasetReader();
+    bool ok() const { return m_data != nullptr; }
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    long long totalRows() const { return m_totalRows; }
+    int nChunks() const { return (int)m_chunkOffsets.size(); }
+      // Decompresses chunk k (replacing the one loaded before) and returns
+      // its number of rows, or -1 if the chunk is damaged
+    int loadChunk(int k);
+      // The rows of the loaded chunk
+    CellKnowledge state(int row, int r, int c) const;
+    Point chosen(int row) const;
+    bool won(int row) const;
+      // We prevent a DatasetReader object from being copied or assigned
+    DatasetReader(const DatasetReader&) = delete;
+    DatasetReader& operator=(const DatasetReader&) = delete;
+
+  private:
+    const uint8_t* m_data;
+    size_t m_size;
+    int m_rows;
+    int m_cols;
+    long long m_totalRows;
+    std::vector<uint64_t> m_chunkOffsets;
+      // The loaded chunk, uncompressed
+    std::vector<std::vector<uint8_t> > m_cellColumns;
+    std::vector<uint8_t> m_chosenColumn;
+    std::vector<uint8_t> m_wonColumn;
+};
+
+#endif // DATASET_INCLUDED
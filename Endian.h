@@ -0,0 +1,52 @@
+#ifndef ENDIAN_INCLUDED
+#define ENDIAN_INCLUDED
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Fixed-width little-endian integers, whatever the host, so the binary files
+// (histograms, shard results, datasets, game indexes, opening books) move
+// between machines. bytes is the width, 1 to 8.
+
+inline uint64_t loadLE(const unsigned char* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int k = 0; k < bytes; k++)
+        v |= (uint64_t)p[k] << (8 * k);
+    return v;
+}
+
+inline void storeLE(unsigned char* p, uint64_t v, int bytes)
+{
+    for (int k = 0; k < bytes; k++)
+        p[k] = (unsigned char)(v >> (8 * k));
+}
+
+  // Appends to a byte buffer (of char or uint8_t)
+template<typename Byte>
+inline void appendLE(std::vector<Byte>& out, uint64_t v, int bytes)
+{
+    for (int k = 0; k < bytes; k++)
+        out.push_back((Byte)(v >> (8 * k)));
+}
+
+inline void writeLE(std::ostream& out, uint64_t v, int bytes)
+{
+    unsigned char b[8];
+    storeLE(b, v, bytes);
+    out.write((const char*)b, bytes);
+}
+
+  // False (leaving v alone) if the stream runs out
+inline bool readLE(std::istream& in, uint64_t& v, int bytes)
+{
+    unsigned char b[8];
+    if (!in.read((char*)b, bytes))
+        return false;
+    v = loadLE(b, bytes);
+    return true;
+}
+
+#endif // ENDIAN_INCLUDED
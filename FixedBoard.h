@@ -0,0 +1,231 @@
+#ifndef FIXEDBOARD_INCLUDED
+#define FIXEDBOARD_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include "Board.h"
+#include "Game.h"
+#include <iostream>
+
+// A board whose dimensions and fleet are template parameters, so every
+// placement mask is a table built at compile time, the loops over ships have
+// constant trip counts the compiler unrolls, and nothing asks the Game how big
+// the board is. It follows BoardImpl's rules exactly, down to block()'s use
+// of the random numbers, so a game plays out the same on either.
+//
+// Board uses StandardBoard -- the 10x10 board with the classic five-ship
+// fleet -- whenever its game is that configuration, and the general BoardImpl
+// for everything else. Build with BATTLESHIP_NO_FIXED_BOARD defined to always
+// use BoardImpl.
+
+template<int... Lengths>
+struct Fleet
+{
+    static constexpr int N = sizeof...(Lengths);
+    static constexpr int length[N] = { Lengths... };
+};
+
+template<int ROWS, int COLS, class F>
+class FixedBoard
+{
+    static_assert(ROWS >= 1 && ROWS <= MAXROWS && COLS >= 1 && COLS <= MAXCOLS, "board too big");
+    static_assert(F::N <= MAXSHIPS, "too many ships");
+
+  public:
+    FixedBoard(const Game& g) : m_game(g) { clear(); }
+
+      // Whether g is this board's configuration
+    static bool fits(const Game& g)
+    {
+        if (g.rows() != ROWS || g.cols() != COLS || g.nShips() != F::N)
+            return false;
+        for (int s = 0; s < F::N; s++)
+            if (g.shipLength(s) != F::length[s])
+                return false;
+        return true;
+    }
+
+    void clear()
+    {
+        m_shots = m_afloat = m_blocked = m_occupied = Bitboard();
+        for (int s = 0; s < F::N; s++)
+            m_shipCells[s] = m_shipAfloat[s] = Bitboard();
+    }
+
+    void block()
+    {
+        // The same draws as BoardImpl::block, so both boards block the same cells
+        int count = 0;
+        while (count < ROWS * COLS / 2){
+            int r = randInt(ROWS);
+            int c = randInt(COLS);
+            if (!(m_occupied | m_blocked | m_shots).test(r, c)){
+                m_blocked.set(r, c);
+                count++;
+            }
+        }
+    }
+
+    void unblock() { m_blocked = Bitboard(); }
+
+    bool placeShip(Point topOrLeft, int shipId, Direction dir)
+    {
+        Bitboard cells = placement(topOrLeft, shipId, dir);
+        // Off the board, already placed, or on top of something
+        if (cells.empty() || m_shipCells[shipId].any() || cells.intersects(m_occupied | m_blocked | m_shots))
+            return false;
+        m_shipCells[shipId] = m_shipAfloat[shipId] = cells;
+        m_occupied |= cells;
+        m_afloat |= cells;
+        return true;
+    }
+
+    bool unplaceShip(Point topOrLeft, int shipId, Direction dir)
+    {
+        Bitboard cells = placement(topOrLeft, shipId, dir);
+        // The whole ship has to be there, with none of it hit
+        if (cells.empty() || m_shipCells[shipId] != cells || cells.intersects(m_shots))
+            return false;
+        m_occupied = m_occupied.andNot(cells);
+        m_afloat = m_afloat.andNot(cells);
+        m_shipCells[shipId] = m_shipAfloat[shipId] = Bitboard();
+        return true;
+    }
+
+    bool attack(Point p, bool& shotHit, bool& shipDestroyed, int& shipId)
+    {
+        shotHit = false;
+        shipDestroyed = false;
+        shipId = -1;
+        if (p.r < 0 || p.c < 0 || p.r >= ROWS || p.c >= COLS || m_shots.test(p.r, p.c))
+            return false;
+        m_shots.set(p.r, p.c);
+        if (!m_afloat.test(p.r, p.c))
+            return true;
+        m_afloat.reset(p.r, p.c);
+        shipId = owner(Bitboard::index(p.r, p.c));
+        m_shipAfloat[shipId].reset(p.r, p.c);
+        shotHit = true;
+        shipDestroyed = m_shipAfloat[shipId].empty();
+        return true;
+    }
+
+    int attackBatch(const Point* shots, int n, ShotResult* results)
+    {
+        // Same two passes as BoardImpl::attackBatch
+        Bitboard batch;
+        int nValid = 0;
+        for (int i = 0; i < n; i++){
+            results[i].shipId = -1;
+            results[i].flags = 0;
+            Point p = shots[i];
+            if (p.r < 0 || p.c < 0 || p.r >= ROWS || p.c >= COLS)
+                continue;
+            if (m_shots.test(p.r, p.c) || batch.test(p.r, p.c))
+                continue;
+            batch.set(p.r, p.c);
+            results[i].flags = ShotResult::VALID;
+            nValid++;
+        }
+        Bitboard hits = batch & m_afloat;
+        m_shots |= batch;
+        m_afloat = m_afloat.andNot(batch);
+        for (int i = 0; i < n; i++){
+            if (!(results[i].flags & ShotResult::VALID) || !hits.test(shots[i].r, shots[i].c))
+                continue;
+            int id = owner(Bitboard::index(shots[i].r, shots[i].c));
+            m_shipAfloat[id].reset(shots[i].r, shots[i].c);
+            results[i].shipId = (signed char)id;
+            results[i].flags |= ShotResult::HIT;
+            if (m_shipAfloat[id].empty())
+                results[i].flags |= ShotResult::DESTROYED;
+        }
+        return nValid;
+    }
+
+    bool allShipsDestroyed() const { return m_afloat.empty(); }
+
+    void display(bool shotsOnly) const
+    {
+        for (int c = 0; c < COLS; c++)
+            std::cout << "  " << c;
+        std::cout << '\n';
+        for (int r = 0; r < ROWS; r++){
+            std::cout << r << " ";
+            for (int c = 0; c < COLS; c++){
+                char ch = '.';
+                if (m_shots.test(r, c))
+                    ch = m_occupied.test(r, c) ? 'X' : 'o';
+                else if (m_occupied.test(r, c))
+                    ch = shotsOnly ? '.' : m_game.shipSymbol(owner(Bitboard::index(r, c)));
+                else if (m_blocked.test(r, c) && !shotsOnly)
+                    ch = '#';
+                std::cout << ch << "  ";
+            }
+            std::cout << '\n';
+        }
+    }
+
+  private:
+      // Every placement of every ship, worked out by the compiler; an empty
+      // mask means the ship doesn't fit there
+    struct Placements
+    {
+        Bitboard mask[F::N][2][ROWS][COLS];
+    };
+
+    static constexpr Placements makePlacements()
+    {
+        Placements p{};
+        for (int s = 0; s < F::N; s++)
+            for (int r = 0; r < ROWS; r++)
+                for (int c = 0; c < COLS; c++){
+                    int len = F::length[s];
+                    Bitboard across, down;
+                    for (int k = 0; k < len; k++){
+                        across = across | Bitboard::cell(r, c + k < MAXCOLS ? c + k : c);
+                        down = down | Bitboard::cell(r + k < MAXROWS ? r + k : r, c);
+                    }
+                    p.mask[s][0][r][c] = c + len <= COLS ? across : Bitboard();
+                    p.mask[s][1][r][c] = r + len <= ROWS ? down : Bitboard();
+                }
+        return p;
+    }
+
+    static constexpr Placements PLACEMENTS = makePlacements();
+
+    static Bitboard placement(Point topOrLeft, int shipId, Direction dir)
+    {
+        if (shipId < 0 || shipId >= F::N || topOrLeft.r < 0 || topOrLeft.c < 0 ||
+                topOrLeft.r >= ROWS || topOrLeft.c >= COLS || (dir != HORIZONTAL && dir != VERTICAL))
+            return Bitboard();
+        return PLACEMENTS.mask[shipId][dir == HORIZONTAL ? 0 : 1][topOrLeft.r][topOrLeft.c];
+    }
+
+      // The ship on a cell that has one
+    int owner(int cell) const
+    {
+        for (int s = 0; s < F::N; s++)
+            if (m_shipCells[s].testBit(cell))
+                return s;
+        return -1;
+    }
+
+    const Game& m_game;     // only for the ship symbols in display
+    Bitboard m_shots;
+    Bitboard m_afloat;
+    Bitboard m_blocked;
+    Bitboard m_occupied;
+    Bitboard m_shipCells[F::N];
+    Bitboard m_shipAfloat[F::N];
+};
+
+typedef Fleet<5, 4, 3, 3, 2> ClassicFleet;
+
+class StandardBoard : public FixedBoard<10, 10, ClassicFleet>
+{
+  public:
+    StandardBoard(const Game& g) : FixedBoard<10, 10, ClassicFleet>(g) {}
+};
+
+#endif // FIXEDBOARD_INCLUDED
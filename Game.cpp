@@ -2,10 +2,17 @@
 #include "Board.h"
 #include "Player.h"
 #include "globals.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Histogram.h"
+#include "GameLog.h"
 #include <iostream>
+#include <chrono>
 #include <string>
 #include <cstdlib>
 #include <cctype>
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 using namespace std;
@@ -22,10 +29,25 @@ class GameImpl
     int nShips() const;
     int shipLength(int shipId) const;
     char shipSymbol(int shipId) const;
-    string shipName(int shipId) const;
-    Player* play(Player* p1, Player* p2, Board& b1, Board& b2, bool shouldPause);
+    const string& shipName(int shipId) const;
+    Player* play(Player* p1, Player* p2, Board& b1, Board& b2, const PlayOptions& opts);
     
 private:
+    // Each seat's clock for the game under way
+    struct Clocks
+    {
+        Clocks() { used[0] = used[1] = 0; overruns[0] = overruns[1] = 0; }
+        long long used[2];
+        int overruns[2];
+    };
+    // Asks the player in the seat for a shot, under the time controls if there are any
+    Point askForShot(Player* p, int seat, Clocks& clocks, const PlayOptions& opts, Histogram* latency);
+    // Helper for the salvo variant: attacker fires a whole turn's worth of shots at once
+    void salvo(Player* attacker, Board& target, int nShots, int turn, Clocks& clocks, const PlayOptions& opts);
+    // The game loop without any console output -- it makes no heap allocations per move
+    Player* playQuietly(Player* p1, Player* p2, Board& b1, Board& b2, int nShots, const PlayOptions& opts);
+    // Fills in opts.result, if it's wanted, and hands back the winner
+    Player* finish(const PlayOptions& opts, Player* p1, Player* winner, int turns, int nShots, const Clocks& clocks);
     int m_rows;
     int m_cols;
     // Create a private class logShips to keep track of stuff.
@@ -34,7 +56,7 @@ private:
         logShips(int slength, char schar, string sname): m_length(slength), m_char(schar), m_name(sname){};
         int length() const {return m_length;}
         char character() const {return m_char;}
-        string name() const {return m_name;}
+        const string& name() const {return m_name;}
     private:
         int m_length;
         char m_char;
@@ -44,12 +66,46 @@ private:
     vector<logShips> m_log;
 };
 
+// How long after its deadline a player has to hand back its shot before the
+// shot counts as an overrun: enough to notice the deadline and return
+const long long LATE_GRACE = 50000;
+
 void waitForEnter()
 {
     cout << "Press enter to continue: ";
     cin.ignore(10000, '\n');
 }
 
+// The player calls of the game loop, each wrapped in a trace point (see Trace.h)
+// and performance counters (see PerfCounters.h)
+bool tracedPlaceShips(Player* p, Board& b)
+{
+    TRACE_SCOPE("placeShips", p->type());
+    PERF_SCOPE("placeShips", p->type());
+    return p->placeShips(b);
+}
+
+Point tracedRecommendAttack(Player* p)
+{
+    TRACE_SCOPE("recommendAttack", p->type());
+    PERF_SCOPE("recommendAttack", p->type());
+    return p->recommendAttack();
+}
+
+void tracedRecordAttackResult(Player* p, Point pt, bool validShot, bool shotHit, bool shipDestroyed, int shipId)
+{
+    TRACE_SCOPE("recordAttackResult", p->type());
+    p->recordAttackResult(pt, validShot, shotHit, shipDestroyed, shipId);
+}
+
+// A one-shot turn's attack, in the form GameLog wants
+void logShot(GameLog* log, int turn, Point p, bool validShot, bool shotHit, bool shipDestroyed, int shipId)
+{
+    int flags = (validShot ? ShotResult::VALID : 0) | (shotHit ? ShotResult::HIT : 0) |
+                (shipDestroyed ? ShotResult::DESTROYED : 0);
+    log->shot(turn % 2, turn, p, flags, shotHit ? shipId : -1);
+}
+
 inline GameImpl::GameImpl(int nRows, int nCols)
 {
     // Valid positions
@@ -133,21 +189,160 @@ char GameImpl::shipSymbol(int shipId) const
     return m_log[shipId].character();
 }
 
-string GameImpl::shipName(int shipId) const
+const string& GameImpl::shipName(int shipId) const
 {
     return m_log[shipId].name();
 }
 
 
-Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, bool shouldPause)
+Point GameImpl::askForShot(Player* p, int seat, Clocks& clocks, const PlayOptions& opts, Histogram* latency)
+{
+    bool timed = opts.moveTime > 0 || opts.gameTime > 0;
+    if (!timed && latency == nullptr)
+        return tracedRecommendAttack(p);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    long long allowed = 0;
+    if (timed){
+        // Whichever runs out first: this shot's time or what's left of the game's
+        allowed = opts.moveTime > 0 ? opts.moveTime : numeric_limits<long long>::max();
+        if (opts.gameTime > 0)
+            allowed = min(allowed, max(0LL, opts.gameTime - clocks.used[seat]));
+        p->setDeadline(start + chrono::nanoseconds(allowed));
+    }
+    Point shot = tracedRecommendAttack(p);
+    long long took = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    if (latency != nullptr)
+        latency->record(took);
+    if (timed){
+        p->setDeadline(chrono::steady_clock::time_point::max());
+        clocks.used[seat] += took;
+        if (took > allowed + LATE_GRACE)
+            clocks.overruns[seat]++;
+    }
+    return shot;
+}
+
+void GameImpl::salvo(Player* attacker, Board& target, int nShots, int turn, Clocks& clocks, const PlayOptions& opts)
+{
+    bool quiet = opts.quiet;
+    // Ask for every shot up front -- the results are only revealed after the whole salvo lands
+    Point shots[MAXROWS * MAXCOLS];
+    ShotResult results[MAXROWS * MAXCOLS];
+    for (int k = 0; k < nShots; k++){
+        shots[k] = askForShot(attacker, turn % 2, clocks, opts, nullptr);
+        attacker->recordShotPending(shots[k]);
+    }
+    target.attackBatch(shots, nShots, results);
+    
+    for (int k = 0; k < nShots; k++){
+        bool validShot = (results[k].flags & ShotResult::VALID) != 0;
+        bool shotHit = (results[k].flags & ShotResult::HIT) != 0;
+        bool shipDestroyed = (results[k].flags & ShotResult::DESTROYED) != 0;
+        tracedRecordAttackResult(attacker, shots[k], validShot, shotHit, shipDestroyed, results[k].shipId);
+        if (opts.log != nullptr)
+            opts.log->shot(turn % 2, turn, shots[k], results[k].flags, results[k].shipId);
+        if (quiet)
+            continue;
+        
+        // Shoot prompts
+        cout << attacker->name();
+        if (!validShot){
+            cout << " wasted a shot at (" << shots[k].r << "," << shots[k].c << ")" << endl;
+            continue;
+        }
+        cout << " attacked (" << shots[k].r << "," << shots[k].c << ") and ";
+        if (shipDestroyed)
+            cout << "destroyed the " << shipName(results[k].shipId) << endl;
+        else if (shotHit)
+            cout << "hit something" << endl;
+        else
+            cout << "missed" << endl;
+    }
+    if (quiet)
+        return;
+    cout << "Resulting in:" << endl;
+    target.display(attacker->isHuman());
+}
+
+Player* GameImpl::finish(const PlayOptions& opts, Player* p1, Player* winner, int turns, int nShots, const Clocks& clocks)
+{
+    if (opts.log != nullptr)
+        opts.log->endGame(winner == nullptr ? -1 : (winner == p1 ? 0 : 1), turns);
+    if (opts.result != nullptr){
+        opts.result->winner = winner;
+        opts.result->turns = turns;
+        // p1 moves on the even turns, so it gets the extra one when the count is odd
+        opts.result->shots[0] = (turns + 1) / 2 * nShots;
+        opts.result->shots[1] = turns / 2 * nShots;
+        for (int seat = 0; seat < 2; seat++){
+            opts.result->overruns[seat] = clocks.overruns[seat];
+            opts.result->timeUsed[seat] = clocks.used[seat];
+        }
+    }
+    return winner;
+}
+
+Player* GameImpl::playQuietly(Player* p1, Player* p2, Board& b1, Board& b2, int nShots, const PlayOptions& opts)
 {
+    TRACE_SCOPE("turns", "game");
+    // Same turn order as play(): p1 shoots on even turns, p2 on odd ones
+    Clocks clocks;
+    int i = 0;
+    for (; !b1.allShipsDestroyed() && !b2.allShipsDestroyed(); i++){
+        Player* attacker = (i % 2 == 0) ? p1 : p2;
+        Board& target = (i % 2 == 0) ? b2 : b1;
+        if (nShots > 1){
+            salvo(attacker, target, nShots, i, clocks, opts);
+            continue;
+        }
+        bool shotHit, shipDestroyed;
+        int shipId;
+        Point attack = askForShot(attacker, i % 2, clocks, opts, opts.moveLatency);
+        bool validShot = target.attack(attack, shotHit, shipDestroyed, shipId);
+        tracedRecordAttackResult(attacker, attack, validShot, shotHit, shipDestroyed, shipId);
+        if (opts.log != nullptr)
+            logShot(opts.log, i, attack, validShot, shotHit, shipDestroyed, shipId);
+    }
+    // Whoever still has ships afloat wins
+    if (b1.allShipsDestroyed())
+        return finish(opts, p1, p2, i, nShots, clocks);
+    return finish(opts, p1, p1, i, nShots, clocks);
+}
+
+Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, const PlayOptions& opts)
+{
+    bool shouldPause = opts.shouldPause;
+    // A salvo can't be bigger than the board
+    int nShots = opts.shotsPerTurn;
+    if (nShots > rows() * cols())
+        nShots = rows() * cols();
+    
+    TRACE_SCOPE("Game::play", "game");
+    
+    // Start both sides from scratch -- the boards and players may be left over from another game
+    b1.clear();
+    b2.clear();
+    p1->resetForNewGame();
+    p2->resetForNewGame();
+    
+    if (opts.log != nullptr)
+        opts.log->startGame();
+    
     // IF either board can't place ships return nullptr
-    if (!p1->placeShips(b1) || !p2->placeShips(b2))
-        return nullptr;
+    if (!tracedPlaceShips(p1, b1) || !tracedPlaceShips(p2, b2))
+        return finish(opts, p1, nullptr, 0, nShots, Clocks());
+    
+    // Simulation farms don't want the console traffic
+    if (opts.quiet)
+        return playQuietly(p1, p2, b1, b2, nShots, opts);
     
     // At this point the ships for both players have been successfully placed
     // While all ships remain on the board
-    for (int i = 0; !b1.allShipsDestroyed() && !b2.allShipsDestroyed(); i++){
+    Clocks clocks;
+    int i = 0;
+    for (; !b1.allShipsDestroyed() && !b2.allShipsDestroyed(); i++){
+        TRACE_SCOPE("turn", "game");
         // IF the 3rd parameter says to pause
         if (shouldPause && i != 0){
             cout << "Press enter to continue: ";
@@ -165,13 +360,21 @@ Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, bool should
             if (!p1->isHuman())
                 b2.display(false);
             
+            // Salvo variant
+            if (nShots > 1){
+                salvo(p1, b2, nShots, i, clocks, opts);
+                continue;
+            }
+            
             // Attack as this player
             bool shotHit, shipDestroyed, validShot = false;
             int shipId;
-            Point attack = p1->recommendAttack();
+            Point attack = askForShot(p1, 0, clocks, opts, nullptr);
             if (b2.attack(attack, shotHit, shipDestroyed, shipId))
                 validShot = true;
-            p1->recordAttackResult(attack, validShot, shotHit, shipDestroyed, shipId);
+            tracedRecordAttackResult(p1, attack, validShot, shotHit, shipDestroyed, shipId);
+            if (opts.log != nullptr)
+                logShot(opts.log, i, attack, validShot, shotHit, shipDestroyed, shipId);
             
             // Shoot prompts
             cout << p1->name();
@@ -204,13 +407,21 @@ Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, bool should
             if (!p2->isHuman())
                 b1.display(false);
             
+            // Salvo variant
+            if (nShots > 1){
+                salvo(p2, b1, nShots, i, clocks, opts);
+                continue;
+            }
+            
             // Attack as this player
             bool shotHit, shipDestroyed, validShot = false;
             int shipId;
-            Point attack = p2->recommendAttack();
+            Point attack = askForShot(p2, 1, clocks, opts, nullptr);
             if (b1.attack(attack, shotHit, shipDestroyed, shipId))
                 validShot = true;
-            p2->recordAttackResult(attack, validShot, shotHit, shipDestroyed, shipId);
+            tracedRecordAttackResult(p2, attack, validShot, shotHit, shipDestroyed, shipId);
+            if (opts.log != nullptr)
+                logShot(opts.log, i, attack, validShot, shotHit, shipDestroyed, shipId);
             
             // Shoot prompts
             cout << p2->name();
@@ -244,7 +455,7 @@ Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, bool should
         if (p1->isHuman())
             b2.display(true);
         cout << p2->name() << " wins!" << endl;
-        return p2;
+        return finish(opts, p1, p2, i, nShots, clocks);
     }
     // Otherwise if the board of player 2 has all its ships destroyed -- p1 won
     if (b2.allShipsDestroyed()){
@@ -252,12 +463,12 @@ Player* GameImpl::play(Player* p1, Player* p2, Board& b1, Board& b2, bool should
         if (p2->isHuman())
             b1.display(true);
         cout << p1->name() << " wins!" << endl;
-        return p1;
+        return finish(opts, p1, p1, i, nShots, clocks);
     }
     
     // Should never happen but if neither player wins
     cout << "Wow this is peculiar! Seems like a draw occured??? Odd... We're working on this!" << endl;
-    return nullptr;
+    return finish(opts, p1, nullptr, i, nShots, clocks);
     
 }
 
@@ -367,7 +578,7 @@ char Game::shipSymbol(int shipId) const
     return m_impl->shipSymbol(shipId);
 }
 
-string Game::shipName(int shipId) const
+const string& Game::shipName(int shipId) const
 {
     assert(shipId >= 0  &&  shipId < nShips());
     return m_impl->shipName(shipId);
@@ -375,10 +586,29 @@ string Game::shipName(int shipId) const
 
 Player* Game::play(Player* p1, Player* p2, bool shouldPause)
 {
-    if (p1 == nullptr  ||  p2 == nullptr  ||  nShips() == 0)
-        return nullptr;
+    PlayOptions opts;
+    opts.shouldPause = shouldPause;
+    return play(p1, p2, opts);
+}
+
+Player* Game::play(Player* p1, Player* p2, const PlayOptions& opts)
+{
     Board b1(*this);
     Board b2(*this);
-    return m_impl->play(p1, p2, b1, b2, shouldPause);
+    return play(p1, p2, b1, b2, opts);
+}
+
+Player* Game::play(Player* p1, Player* p2, Board& b1, Board& b2,
+                   const PlayOptions& opts)
+{
+    if (p1 == nullptr  ||  p2 == nullptr  ||  nShips() == 0)
+        return nullptr;
+    if (opts.shotsPerTurn < 1)
+    {
+        cout << "Bad number of shots per turn " << opts.shotsPerTurn
+             << "; it must be >= 1" << endl;
+        return nullptr;
+    }
+    return m_impl->play(p1, p2, b1, b2, opts);
 }
 
@@ -6,7 +6,54 @@
 
 class Point;
 class Player;
+class Board;
 class GameImpl;
+class Histogram;
+class GameLog;
+
+  // What happened in a game
+struct GameResult
+{
+    GameResult() : winner(nullptr), turns(0)
+    {
+        shots[0] = shots[1] = 0;
+        overruns[0] = overruns[1] = 0;
+        timeUsed[0] = timeUsed[1] = 0;
+    }
+    Player* winner;       // nullptr if the ships couldn't be placed
+    int turns;            // turns taken by both players together
+    int shots[2];         // shots fired by p1 and by p2, wasted ones included
+    int overruns[2];      // moves p1 and p2 took longer over than they were allowed
+    long long timeUsed[2];  // nanoseconds p1 and p2 spent choosing shots (only
+                            // measured under time controls)
+};
+
+  // Knobs for Game::play beyond the classic one-shot-per-turn game
+struct PlayOptions
+{
+    PlayOptions()
+     : shouldPause(true), shotsPerTurn(1), quiet(false),
+       result(nullptr), moveLatency(nullptr), log(nullptr),
+       moveTime(0), gameTime(0)
+    {}
+    bool shouldPause;
+    int shotsPerTurn;     // more than 1 plays the "salvo" variant
+    bool quiet;           // no console output and no heap allocations per move
+    GameResult* result;   // if set, filled in when the game is over
+    Histogram* moveLatency;  // if set, gets the nanoseconds each recommendAttack
+                             // took (quiet one-shot games only)
+    GameLog* log;         // if set, every shot is logged to it (see GameLog.h)
+      // Time controls, in nanoseconds (0 for no limit): how long one shot may
+      // take, and how long all of a player's shots in a game may take
+      // together. Each shot is due by the earlier of the two limits (see
+      // Player::deadline). A player can't be interrupted, so one that runs
+      // over (by more than a few tens of microseconds, the time it takes to
+      // notice the deadline) still gets its shot, and the overrun is counted
+      // in the result. One that has used up its game time gets a deadline of
+      // now for every shot.
+    long long moveTime;
+    long long gameTime;
+};
 
 class Game
 {
@@ -21,8 +68,13 @@ class Game
     int nShips() const;
     int shipLength(int shipId) const;
     char shipSymbol(int shipId) const;
-    std::string shipName(int shipId) const;
+    const std::string& shipName(int shipId) const;
     Player* play(Player* p1, Player* p2, bool shouldPause = true);
+    Player* play(Player* p1, Player* p2, const PlayOptions& opts);
+      // Plays on boards supplied by the caller, clearing them first, so the
+      // same two boards can be reused for game after game
+    Player* play(Player* p1, Player* p2, Board& b1, Board& b2,
+                 const PlayOptions& opts);
       // We prevent a Game object from being copied or assigned
     Game(const Game&) = delete;
     Game& operator=(const Game&) = delete;
@@ -0,0 +1,428 @@
+#include "GameIndex.h"
+#include "Game.h"
+#include "Board.h"
+#include "Endian.h"
+#include "Histogram.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[4] = { 'B', 'S', 'G', 'I' };
+const uint32_t VERSION = 1;
+const uint16_t NO_HIT = 0xffff;
+
+void putString(vector<char>& out, const string& s)
+{
+    appendLE(out, s.size(), 4);
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+template<typename T>
+void putColumn(vector<char>& out, const vector<T>& column)
+{
+    for (size_t k = 0; k < column.size(); k++)
+        appendLE(out, (uint64_t)column[k], sizeof(T));
+}
+
+  // Reads from a buffer; once anything runs off the end, everything fails
+class Cursor
+{
+  public:
+    Cursor(const vector<char>& data) : m_data(data), m_pos(0), m_ok(true) {}
+    bool ok() const { return m_ok; }
+    uint64_t get(int bytes)
+    {
+        if (m_pos + bytes > m_data.size()){
+            m_ok = false;
+            return 0;
+        }
+        uint64_t v = loadLE((const unsigned char*)&m_data[m_pos], bytes);
+        m_pos += bytes;
+        return v;
+    }
+    string getString()
+    {
+        uint64_t n = get(4);
+        if (m_pos + n > m_data.size()){
+            m_ok = false;
+            return "";
+        }
+        string s(&m_data[0] + m_pos, n);
+        m_pos += n;
+        return s;
+    }
+    template<typename T>
+    void getColumn(vector<T>& column, size_t n)
+    {
+        if (m_pos + n * sizeof(T) > m_data.size()){
+            m_ok = false;
+            return;
+        }
+        column.resize(n);
+        for (size_t k = 0; k < n; k++)
+            column[k] = (T)get(sizeof(T));
+    }
+  private:
+    const vector<char>& m_data;
+    size_t m_pos;
+    bool m_ok;
+};
+
+const string NO_NAME;
+
+} // namespace
+
+//*********************************************************************
+//  GameIndexWriter
+//*********************************************************************
+
+GameIndexWriter::GameIndexWriter(const Game& g, const string& path)
+ : m_game(g), m_path(path), m_closed(false)
+{}
+
+GameIndexWriter::~GameIndexWriter()
+{
+    if (!m_closed)
+        close();
+}
+
+void GameIndexWriter::nameTag(int tag, const string& seat0, const string& seat1)
+{
+    m_tags[tag] = make_pair(seat0, seat1);
+}
+
+void GameIndexWriter::write(const GameEvent* events, int n)
+{
+    for (int k = 0; k < n; k++){
+        const GameEvent& e = events[k];
+        if (e.producer >= m_inGame.size()){
+            m_inGame.resize(e.producer + 1);
+            m_started.resize(e.producer + 1, false);
+        }
+        InGame& g = m_inGame[e.producer];
+
+        if (e.kind == GameEvent::START){
+            m_started[e.producer] = true;
+            g.game = e.game;
+            g.tag = e.tag;
+            g.firstHit[0] = g.firstHit[1] = NO_HIT;
+            g.lastSunk[0] = g.lastSunk[1] = -1;
+            continue;
+        }
+        if (!m_started[e.producer] || e.game != g.game || (e.kind == GameEvent::SHOT && e.seat > 1))
+            continue;
+
+        if (e.kind == GameEvent::SHOT){
+            if ((e.flags & ShotResult::HIT) != 0 && g.firstHit[e.seat] == NO_HIT)
+                g.firstHit[e.seat] = e.turn;
+            if ((e.flags & ShotResult::DESTROYED) != 0)
+                g.lastSunk[e.seat] = e.shipId;
+            continue;
+        }
+
+        // The game is over: one more entry in every column
+        m_producer.push_back(e.producer);
+        m_gameNo.push_back(e.game);
+        m_tag.push_back(g.tag);
+        m_winner.push_back(e.seat);
+        m_turns.push_back(e.turn);
+        m_firstHit[0].push_back(g.firstHit[0]);
+        m_firstHit[1].push_back(g.firstHit[1]);
+        m_endShip.push_back((int8_t)(e.seat <= 1 ? g.lastSunk[e.seat] : -1));
+        m_started[e.producer] = false;
+    }
+}
+
+bool GameIndexWriter::close()
+{
+    m_closed = true;
+    size_t n = m_turns.size();
+    vector<char> out(MAGIC, MAGIC + 4);
+    appendLE(out, VERSION, 4);
+    appendLE(out, m_game.nShips(), 4);
+    appendLE(out, n, 8);
+    appendLE(out, m_tags.size(), 4);
+    for (map<int, pair<string, string> >::const_iterator p = m_tags.begin(); p != m_tags.end(); p++){
+        appendLE(out, p->first, 2);
+        putString(out, p->second.first);
+        putString(out, p->second.second);
+    }
+    putColumn(out, m_producer);
+    putColumn(out, m_gameNo);
+    putColumn(out, m_tag);
+    putColumn(out, m_winner);
+    putColumn(out, m_turns);
+    putColumn(out, m_firstHit[0]);
+    putColumn(out, m_firstHit[1]);
+
+    // The bitmaps: who won, then which ship's sinking ended the game
+    vector<GameSelection> bitmaps(2 + m_game.nShips(), GameSelection(n));
+    for (size_t k = 0; k < n; k++){
+        if (m_winner[k] <= 1)
+            bitmaps[m_winner[k]].add(k);
+        if (m_endShip[k] >= 0 && m_endShip[k] < m_game.nShips())
+            bitmaps[2 + m_endShip[k]].add(k);
+    }
+    for (size_t b = 0; b < bitmaps.size(); b++)
+        for (long long w = 0; w < (long long)(n + 63) / 64; w++)
+            appendLE(out, bitmaps[b].m_bits[w], 8);
+
+    ofstream f(m_path.c_str(), ios::binary);
+    f.write(&out[0], out.size());
+    f.close();
+    return bool(f);
+}
+
+//*********************************************************************
+//  GameSelection
+//*********************************************************************
+
+GameSelection::GameSelection(long long nGames)
+ : m_n(nGames), m_bits((nGames + 63) / 64, 0)
+{}
+
+long long GameSelection::count() const
+{
+    long long n = 0;
+    for (size_t w = 0; w < m_bits.size(); w++)
+        n += __builtin_popcountll(m_bits[w]);
+    return n;
+}
+
+long long GameSelection::next(long long game) const
+{
+    if (game < 0)
+        game = 0;
+    for (size_t w = game / 64; w < m_bits.size(); w++){
+        uint64_t bits = m_bits[w];
+        if (w == (size_t)(game / 64))
+            bits &= ~uint64_t(0) << (game % 64);
+        if (bits != 0)
+            return w * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+GameSelection GameSelection::operator&(const GameSelection& o) const
+{
+    GameSelection s(*this);
+    for (size_t w = 0; w < s.m_bits.size() && w < o.m_bits.size(); w++)
+        s.m_bits[w] &= o.m_bits[w];
+    return s;
+}
+
+GameSelection GameSelection::operator|(const GameSelection& o) const
+{
+    GameSelection s(*this);
+    for (size_t w = 0; w < s.m_bits.size() && w < o.m_bits.size(); w++)
+        s.m_bits[w] |= o.m_bits[w];
+    return s;
+}
+
+GameSelection GameSelection::operator~() const
+{
+    GameSelection s(*this);
+    for (size_t w = 0; w < s.m_bits.size(); w++)
+        s.m_bits[w] = ~s.m_bits[w];
+    // Keep the bits past the last game clear
+    if (m_n % 64 != 0)
+        s.m_bits.back() &= (uint64_t(1) << (m_n % 64)) - 1;
+    return s;
+}
+
+//*********************************************************************
+//  GameIndex
+//*********************************************************************
+
+GameIndex::GameIndex(const string& path)
+ : m_ok(false)
+{
+    ifstream f(path.c_str(), ios::binary);
+    vector<char> data((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    Cursor in(data);
+    if (data.size() < 4 || !equal(MAGIC, MAGIC + 4, data.begin()))
+        return;
+    in.get(4);
+    if (in.get(4) != VERSION)
+        return;
+    int nShips = (int)in.get(4);
+    size_t n = in.get(8);
+    size_t nTags = in.get(4);
+    // Every game takes at least 14 bytes, so a bigger count means a damaged file
+    if (!in.ok() || n > data.size() / 14 || nShips > 1000 || nTags > 65536)
+        return;
+    for (size_t k = 0; k < nTags && in.ok(); k++){
+        int tag = (int)in.get(2);
+        string seat0 = in.getString();
+        m_tags[tag] = make_pair(seat0, in.getString());
+    }
+    in.getColumn(m_producer, n);
+    in.getColumn(m_gameNo, n);
+    in.getColumn(m_tag, n);
+    in.getColumn(m_winner, n);
+    in.getColumn(m_turns, n);
+    in.getColumn(m_firstHit[0], n);
+    in.getColumn(m_firstHit[1], n);
+
+    m_finalSink.assign(nShips, GameSelection(n));
+    for (int b = 0; b < 2 + nShips && in.ok(); b++){
+        GameSelection& s = b < 2 ? m_wonBy[b] : m_finalSink[b - 2];
+        s = GameSelection(n);
+        for (size_t w = 0; w < s.m_bits.size(); w++)
+            s.m_bits[w] = in.get(8);
+    }
+    m_ok = in.ok();
+    if (!m_ok)
+        m_turns.clear();
+}
+
+vector<string> GameIndex::strategies() const
+{
+    vector<string> names;
+    for (map<int, pair<string, string> >::const_iterator p = m_tags.begin(); p != m_tags.end(); p++)
+        for (int seat = 0; seat < 2; seat++){
+            const string& s = seat == 0 ? p->second.first : p->second.second;
+            if (find(names.begin(), names.end(), s) == names.end())
+                names.push_back(s);
+        }
+    return names;
+}
+
+const string& GameIndex::strategy(long long game, int seat) const
+{
+    map<int, pair<string, string> >::const_iterator p = m_tags.find(m_tag[game]);
+    if (p == m_tags.end())
+        return NO_NAME;
+    return seat == 0 ? p->second.first : p->second.second;
+}
+
+GameSelection GameIndex::all() const
+{
+    return ~GameSelection(nGames());
+}
+
+GameSelection GameIndex::longerThan(int turns) const
+{
+    GameSelection s(nGames());
+    for (long long k = 0; k < nGames(); k++)
+        if (m_turns[k] > turns)
+            s.add(k);
+    return s;
+}
+
+GameSelection GameIndex::wonBySeat(int seat) const
+{
+    if (seat < 0 || seat > 1)
+        return GameSelection(nGames());
+    return m_wonBy[seat];
+}
+
+GameSelection GameIndex::endedBySinking(int shipId) const
+{
+    if (shipId < 0 || shipId >= (int)m_finalSink.size())
+        return GameSelection(nGames());
+    return m_finalSink[shipId];
+}
+
+GameSelection GameIndex::withTag(int tag) const
+{
+    GameSelection s(nGames());
+    for (long long k = 0; k < nGames(); k++)
+        if (m_tag[k] == tag)
+            s.add(k);
+    return s;
+}
+
+vector<uint8_t> GameIndex::seatsOf(const string& strategy) const
+{
+    vector<uint8_t> seats(65536, 0);
+    for (map<int, pair<string, string> >::const_iterator p = m_tags.begin(); p != m_tags.end(); p++)
+        seats[p->first & 0xffff] = (p->second.first == strategy ? 1 : 0) | (p->second.second == strategy ? 2 : 0);
+    return seats;
+}
+
+GameSelection GameIndex::playedBy(const string& strategy) const
+{
+    vector<uint8_t> seats = seatsOf(strategy);
+    GameSelection s(nGames());
+    for (long long k = 0; k < nGames(); k++)
+        if (seats[m_tag[k]] != 0)
+            s.add(k);
+    return s;
+}
+
+GameSelection GameIndex::wonBy(const string& strategy) const
+{
+    vector<uint8_t> seats = seatsOf(strategy);
+    GameSelection s(nGames());
+    for (long long k = 0; k < nGames(); k++)
+        if (m_winner[k] <= 1 && (seats[m_tag[k]] >> m_winner[k] & 1) != 0)
+            s.add(k);
+    return s;
+}
+
+void GameIndex::turns(const GameSelection& s, Histogram& h) const
+{
+    for (long long k = s.next(0); k >= 0; k = s.next(k + 1))
+        h.record(m_turns[k]);
+}
+
+void GameIndex::firstHitTurns(const GameSelection& s, const string& strategy, Histogram& h) const
+{
+    vector<uint8_t> seats = seatsOf(strategy);
+    for (long long k = s.next(0); k >= 0; k = s.next(k + 1))
+        for (int seat = 0; seat < 2; seat++)
+            if ((seats[m_tag[k]] >> seat & 1) != 0 && m_firstHit[seat][k] != NO_HIT)
+                h.record(m_firstHit[seat][k]);
+}
+
+// Log a corpus with its index, then ask it some questions
+/*
+#include "Player.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    {
+        EventFile corpus("games.log");
+        GameIndexWriter index(g, "games.idx");
+        index.nameTag(0, "good", "mediocre");
+        index.nameTag(1, "mediocre", "good");
+        {
+            SinkTee both(corpus, index);
+            LogWriter w(both);
+            Player* good = createPlayer("good", "g", g);
+            Player* mediocre = createPlayer("mediocre", "m", g);
+            Board b1(g), b2(g);
+            PlayOptions opts;
+            opts.quiet = true;
+            opts.log = w.producer();
+            for (int k = 0; k < 10000; k++){
+                opts.log->setTag(k % 2);
+                if (k % 2 == 0)
+                    g.play(good, mediocre, b1, b2, opts);
+                else
+                    g.play(mediocre, good, b1, b2, opts);
+            }
+            delete good;
+            delete mediocre;
+        }
+        index.close();
+    }
+    GameIndex idx("games.idx");
+    cout << idx.nGames() << " games" << endl;
+    cout << "ended by sinking the carrier: " << idx.endedBySinking(0).count() << endl;
+    cout << "longer than 150 turns: " << idx.longerThan(150).count() << endl;
+    cout << "good won: " << idx.wonBy("good").count() << endl;
+    for (string s : idx.strategies()){
+        Histogram h;
+        idx.firstHitTurns(idx.all(), s, h);
+        cout << s << " first hit on turn " << h.percentile(0.5) << " (median)" << endl;
+    }
+}
+*/
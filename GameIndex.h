@@ -0,0 +1,140 @@
+#ifndef GAMEINDEX_INCLUDED
+#define GAMEINDEX_INCLUDED
+
+#include "GameLog.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Game;
+class Histogram;
+
+// A side index over a corpus of logged games, so questions about millions of
+// games ("longer than 150 turns", "ended by sinking the carrier", "when did
+// each strategy land its first hit") are answered from a few summary columns
+// instead of by replaying everything.
+//
+// A GameIndexWriter is an EventSink; put it behind the same LogWriter as the
+// corpus itself with a SinkTee and it summarizes each game as it's logged:
+//
+//     EventFile corpus("games.log");
+//     GameIndexWriter index(g, "games.idx");
+//     SinkTee both(corpus, index);
+//     LogWriter w(both);
+//
+// The games played under each GameLog tag are credited to the strategies
+// named with nameTag. Each game gets one entry in every column (the producer
+// and game number that find it in the corpus, its tag, winner, length, and
+// the turn of each seat's first hit), and the yes/no facts are kept as
+// bitmaps (who won, which ship's sinking ended it).
+
+class GameIndexWriter : public EventSink
+{
+  public:
+    GameIndexWriter(const Game& g, const std::string& path);
+      // Calls close if that hasn't been done
+    ~GameIndexWriter();
+      // The games logged with this tag have seat0 moving first against seat1
+    void nameTag(int tag, const std::string& seat0, const std::string& seat1);
+    virtual void write(const GameEvent* events, int n);
+      // Writes the index out; do it once the LogWriter is finished
+    bool close();
+      // We prevent a GameIndexWriter object from being copied or assigned
+    GameIndexWriter(const GameIndexWriter&) = delete;
+    GameIndexWriter& operator=(const GameIndexWriter&) = delete;
+
+  private:
+    struct InGame
+    {
+        uint32_t game;
+        uint16_t tag;
+        uint16_t firstHit[2];
+        int lastSunk[2];      // the last ship each seat sank
+    };
+
+    const Game& m_game;
+    std::string m_path;
+    bool m_closed;
+    std::map<int, std::pair<std::string, std::string> > m_tags;
+    std::vector<InGame> m_inGame;   // by producer
+    std::vector<bool> m_started;
+      // The columns
+    std::vector<uint16_t> m_producer;
+    std::vector<uint32_t> m_gameNo;
+    std::vector<uint16_t> m_tag;
+    std::vector<uint8_t> m_winner;
+    std::vector<uint16_t> m_turns;
+    std::vector<uint16_t> m_firstHit[2];
+    std::vector<int8_t> m_endShip;    // the ship whose sinking ended the game, or -1
+};
+
+  // A set of games in an index, one bit each
+class GameSelection
+{
+  public:
+    GameSelection(long long nGames = 0);
+    long long size() const { return m_n; }
+    bool contains(long long game) const { return (m_bits[game / 64] >> (game % 64)) & 1; }
+    void add(long long game) { m_bits[game / 64] |= uint64_t(1) << (game % 64); }
+    long long count() const;
+      // The first selected game from game on, or -1 if there's none
+    long long next(long long game) const;
+
+    GameSelection operator&(const GameSelection& o) const;
+    GameSelection operator|(const GameSelection& o) const;
+    GameSelection operator~() const;
+
+  private:
+    friend class GameIndex;
+    friend class GameIndexWriter;
+    long long m_n;
+    std::vector<uint64_t> m_bits;
+};
+
+class GameIndex
+{
+  public:
+    GameIndex(const std::string& path);
+    bool ok() const { return m_ok; }
+    long long nGames() const { return (long long)m_turns.size(); }
+    std::vector<std::string> strategies() const;
+      // Who played a seat of a game, or "" if its tag wasn't named
+    const std::string& strategy(long long game, int seat) const;
+      // Where to find a game in the corpus
+    int producer(long long game) const { return m_producer[game]; }
+    uint32_t gameNumber(long long game) const { return m_gameNo[game]; }
+
+      // Selections; each looks at one or two columns only
+    GameSelection all() const;
+    GameSelection longerThan(int turns) const;
+    GameSelection wonBySeat(int seat) const;
+    GameSelection endedBySinking(int shipId) const;
+    GameSelection withTag(int tag) const;
+    GameSelection playedBy(const std::string& strategy) const;
+    GameSelection wonBy(const std::string& strategy) const;
+
+      // Aggregates over a selection
+    void turns(const GameSelection& s, Histogram& h) const;
+      // The turn on which the strategy first hit something, in the selected
+      // games it played; games where it never hit anything are left out
+    void firstHitTurns(const GameSelection& s, const std::string& strategy, Histogram& h) const;
+
+  private:
+      // For each tag, which seats the strategy played (bit 0 and bit 1)
+    std::vector<uint8_t> seatsOf(const std::string& strategy) const;
+
+    bool m_ok;
+    std::map<int, std::pair<std::string, std::string> > m_tags;
+    std::vector<uint16_t> m_producer;
+    std::vector<uint32_t> m_gameNo;
+    std::vector<uint16_t> m_tag;
+    std::vector<uint8_t> m_winner;
+    std::vector<uint16_t> m_turns;
+    std::vector<uint16_t> m_firstHit[2];
+    GameSelection m_wonBy[2];
+    std::vector<GameSelection> m_finalSink;   // by ship
+};
+
+#endif // GAMEINDEX_INCLUDED
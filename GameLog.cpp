@@ -0,0 +1,253 @@
+#include "GameLog.h"
+#include <chrono>
+#include <fstream>
+
+using namespace std;
+
+//*********************************************************************
+//  EventRing
+//*********************************************************************
+
+EventRing::EventRing(int capacity)
+ : m_tail(0), m_headSeen(0), m_head(0)
+{
+    uint64_t size = 1;
+    while (size < (uint64_t)capacity)
+        size *= 2;
+    m_events.resize(size);
+    m_mask = size - 1;
+}
+
+bool EventRing::push(const GameEvent& e)
+{
+    uint64_t tail = m_tail.load(memory_order_relaxed);
+    // Only look at the consumer's index (and pull its cache line over) when the
+    // ring seemed full last time
+    if (tail - m_headSeen > m_mask){
+        m_headSeen = m_head.load(memory_order_acquire);
+        if (tail - m_headSeen > m_mask)
+            return false;
+    }
+    m_events[tail & m_mask] = e;
+    m_tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+int EventRing::pop(GameEvent* out, int max)
+{
+    uint64_t head = m_head.load(memory_order_relaxed);
+    uint64_t n = m_tail.load(memory_order_acquire) - head;
+    if (n > (uint64_t)max)
+        n = max;
+    for (uint64_t k = 0; k < n; k++)
+        out[k] = m_events[(head + k) & m_mask];
+    m_head.store(head + n, memory_order_release);
+    return (int)n;
+}
+
+//*********************************************************************
+//  GameLog
+//*********************************************************************
+
+GameLog::GameLog(LogWriter& w, int id, int capacity)
+ : m_writer(w), m_ring(capacity), m_id((uint16_t)id), m_tag(0), m_game(0), m_stalls(0)
+{}
+
+void GameLog::put(GameEvent& e)
+{
+    e.producer = m_id;
+    e.game = m_game;
+    e.tag = m_tag;
+    if (m_ring.push(e))
+        return;
+    // Backpressure: the writer is behind, so hurry it up and wait for room
+    m_stalls.store(m_stalls.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    m_writer.wake();
+    while (!m_ring.push(e))
+        this_thread::yield();
+}
+
+void GameLog::startGame()
+{
+    m_game++;
+    GameEvent e = GameEvent();
+    e.kind = GameEvent::START;
+    e.shipId = -1;
+    put(e);
+}
+
+void GameLog::shot(int seat, int turn, Point p, int flags, int shipId)
+{
+    GameEvent e;
+    e.kind = GameEvent::SHOT;
+    e.seat = (uint8_t)seat;
+    e.turn = (uint16_t)turn;
+    e.r = (int8_t)p.r;
+    e.c = (int8_t)p.c;
+    e.flags = (uint8_t)flags;
+    e.shipId = (int8_t)shipId;
+    put(e);
+}
+
+void GameLog::endGame(int winnerSeat, int turns)
+{
+    GameEvent e = GameEvent();
+    e.kind = GameEvent::END;
+    e.seat = winnerSeat < 0 ? 255 : (uint8_t)winnerSeat;
+    e.turn = (uint16_t)turns;
+    e.shipId = -1;
+    put(e);
+}
+
+//*********************************************************************
+//  EventFile
+//*********************************************************************
+
+EventFile::EventFile(const string& path)
+ : m_out(path.c_str(), ios::binary)
+{}
+
+void EventFile::write(const GameEvent* events, int n)
+{
+    m_out.write((const char*)events, n * sizeof(GameEvent));
+}
+
+void EventFile::flush()
+{
+    m_out.flush();
+}
+
+//*********************************************************************
+//  LogWriter
+//*********************************************************************
+
+LogWriter::LogWriter(const string& path, int ringCapacity)
+ : m_capacity(ringCapacity), m_stopping(false), m_written(0), m_batch(4096)
+{
+    EventFile* f = new EventFile(path);
+    m_ok = f->ok();
+    m_sink = m_ownedSink = f;
+    m_thread = thread(&LogWriter::loop, this);
+}
+
+LogWriter::LogWriter(EventSink& sink, int ringCapacity)
+ : m_sink(&sink), m_ownedSink(nullptr), m_ok(true), m_capacity(ringCapacity), m_stopping(false),
+   m_written(0), m_batch(4096)
+{
+    m_thread = thread(&LogWriter::loop, this);
+}
+
+LogWriter::~LogWriter()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+    for (size_t k = 0; k < m_producers.size(); k++)
+        delete m_producers[k];
+    delete m_ownedSink;
+}
+
+GameLog* LogWriter::producer()
+{
+    lock_guard<mutex> lock(m_mutex);
+    GameLog* p = new GameLog(*this, (int)m_producers.size(), m_capacity);
+    m_producers.push_back(p);
+    return p;
+}
+
+long long LogWriter::stalls() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    long long n = 0;
+    for (size_t k = 0; k < m_producers.size(); k++)
+        n += m_producers[k]->stalls();
+    return n;
+}
+
+void LogWriter::wake()
+{
+    m_wake.notify_one();
+}
+
+bool LogWriter::drain()
+{
+    // Work from a copy of the list so producers can be added meanwhile
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_draining = m_producers;
+    }
+    bool any = false;
+    for (size_t k = 0; k < m_draining.size(); k++){
+        EventRing& ring = m_draining[k]->m_ring;
+        // Each batch goes out in one write, in the order it was produced
+        int got;
+        while ((got = ring.pop(&m_batch[0], (int)m_batch.size())) > 0){
+            m_sink->write(&m_batch[0], got);
+            m_written.fetch_add(got, memory_order_relaxed);
+            any = true;
+            if (got < (int)m_batch.size())
+                break;
+        }
+    }
+    return any;
+}
+
+void LogWriter::loop()
+{
+    for (;;){
+        bool stopping;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            stopping = m_stopping;
+        }
+        if (drain())
+            continue;
+        // Nothing was queued, so once we're stopping everything has been written
+        if (stopping)
+            break;
+        m_sink->flush();
+        // The game threads never signal us except when a ring is full, so poll
+        unique_lock<mutex> lock(m_mutex);
+        if (!m_stopping)
+            m_wake.wait_for(lock, chrono::milliseconds(2));
+    }
+    m_sink->flush();
+}
+
+// Log 1000 games from two threads and count what comes out
+/*
+#include "Game.h"
+#include "Board.h"
+#include "Player.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    long long stalls;
+    {
+        LogWriter w("games.log");
+        auto run = [&](){
+            Player* p1 = createPlayer("good", "g1", g);
+            Player* p2 = createPlayer("mediocre", "m2", g);
+            Board b1(g), b2(g);
+            PlayOptions opts;
+            opts.quiet = true;
+            opts.log = w.producer();
+            for (int k = 0; k < 500; k++)
+                g.play(p1, p2, b1, b2, opts);
+            delete p1;
+            delete p2;
+        };
+        thread t(run);
+        run();
+        t.join();
+        stalls = w.stalls();
+    }
+    ifstream in("games.log", ios::binary | ios::ate);
+    cout << in.tellg() / sizeof(GameEvent) << " events, " << stalls << " stalls" << endl;
+}
+*/
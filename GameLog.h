@@ -0,0 +1,163 @@
+#ifndef GAMELOG_INCLUDED
+#define GAMELOG_INCLUDED
+
+#include "globals.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Event logging for games that doesn't slow them down. Each thread running
+// games gets its own GameLog from a LogWriter and sets it in
+// PlayOptions::log; Game::play then records every shot into the GameLog's
+// ring buffer, which costs a couple of stores and no locks, system calls or
+// allocations. The LogWriter's own thread drains all the rings in batches
+// and writes them to one file (or hands them to an EventSink). If the writer
+// falls behind and a ring fills up, the game thread waits for room (and
+// counts the stall) rather than dropping events.
+
+  // One record in the log file (16 bytes, host byte order)
+struct GameEvent
+{
+    enum Kind { START, SHOT, END };
+    uint32_t game;        // game number within the producer
+    uint16_t producer;    // which GameLog wrote it
+    uint8_t kind;
+    uint8_t seat;         // SHOT: who fired (0 moves first); END: the winner, or 255 if none
+    uint16_t turn;        // SHOT: the turn it was fired on; END: turns taken
+    int8_t r, c;
+    uint8_t flags;        // SHOT: ShotResult flags (see Board.h)
+    int8_t shipId;        // SHOT: the ship hit, or -1
+    uint16_t tag;         // the producer's label for the game (see GameLog::setTag)
+};
+
+  // A fixed-size queue between exactly one producer thread and one consumer
+  // thread. Each side owns one index and only reads the other's, so neither
+  // needs a lock; the indexes live on separate cache lines so the two threads
+  // don't keep stealing the line from each other.
+class EventRing
+{
+  public:
+      // capacity is rounded up to a power of two
+    explicit EventRing(int capacity);
+      // Producer side: false if the ring is full
+    bool push(const GameEvent& e);
+      // Consumer side: moves up to max events into out and returns how many
+    int pop(GameEvent* out, int max);
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+  private:
+    std::vector<GameEvent> m_events;
+    uint64_t m_mask;
+    alignas(64) std::atomic<uint64_t> m_tail;   // next slot to write; only the producer stores it
+    uint64_t m_headSeen;                        // producer's last look at m_head
+    alignas(64) std::atomic<uint64_t> m_head;   // next slot to read; only the consumer stores it
+};
+
+  // Where a LogWriter's batches go. write is only ever called from the
+  // writer thread; each producer's events arrive in the order they were
+  // produced, though batches from different producers are interleaved.
+class EventSink
+{
+  public:
+    virtual ~EventSink() {}
+    virtual void write(const GameEvent* events, int n) = 0;
+      // Called when the writer thread has nothing else to do, and at the end
+    virtual void flush() {}
+};
+
+  // Writes the events to a file as they are
+class EventFile : public EventSink
+{
+  public:
+    EventFile(const std::string& path);
+    bool ok() const { return bool(m_out); }
+    virtual void write(const GameEvent* events, int n);
+    virtual void flush();
+  private:
+    std::ofstream m_out;
+};
+
+  // Hands every batch to two sinks
+class SinkTee : public EventSink
+{
+  public:
+    SinkTee(EventSink& a, EventSink& b) : m_a(a), m_b(b) {}
+    virtual void write(const GameEvent* events, int n) { m_a.write(events, n); m_b.write(events, n); }
+    virtual void flush() { m_a.flush(); m_b.flush(); }
+  private:
+    EventSink& m_a;
+    EventSink& m_b;
+};
+
+class LogWriter;
+
+  // A game thread's handle on the log. Only one thread may use it.
+class GameLog
+{
+  public:
+    void startGame();
+    void shot(int seat, int turn, Point p, int flags, int shipId);
+    void endGame(int winnerSeat, int turns);
+      // Labels the events of the games that follow, e.g. with which pairing of
+      // strategies is playing
+    void setTag(int tag) { m_tag = (uint16_t)tag; }
+      // Times this producer found its ring full and had to wait
+    long long stalls() const { return m_stalls.load(std::memory_order_relaxed); }
+
+  private:
+    friend class LogWriter;
+    GameLog(LogWriter& w, int id, int capacity);
+    void put(GameEvent& e);
+
+    LogWriter& m_writer;
+    EventRing m_ring;
+    uint16_t m_id;
+    uint16_t m_tag;
+    uint32_t m_game;
+    std::atomic<long long> m_stalls;
+};
+
+class LogWriter
+{
+  public:
+      // ringCapacity is in events, per producer
+    LogWriter(const std::string& path, int ringCapacity = 1 << 14);
+    LogWriter(EventSink& sink, int ringCapacity = 1 << 14);
+      // Writes out whatever is still queued and stops the thread
+    ~LogWriter();
+    bool ok() const { return m_ok; }
+      // A new producer; it belongs to the LogWriter and lives as long as it does
+    GameLog* producer();
+    long long eventsWritten() const { return m_written.load(std::memory_order_relaxed); }
+    long long stalls() const;
+      // We prevent a LogWriter object from being copied or assigned
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+  private:
+    friend class GameLog;
+    void loop();
+    bool drain();
+    void wake();
+
+    EventSink* m_sink;
+    EventSink* m_ownedSink;   // the file, if we opened it
+    bool m_ok;
+    int m_capacity;
+    std::vector<GameLog*> m_producers;
+    std::vector<GameLog*> m_draining;   // the writer thread's copy of m_producers
+    mutable std::mutex m_mutex;     // guards m_producers and the sleep below
+    std::condition_variable m_wake;
+    bool m_stopping;
+    std::atomic<long long> m_written;
+    std::vector<GameEvent> m_batch;
+    std::thread m_thread;
+};
+
+#endif // GAMELOG_INCLUDED
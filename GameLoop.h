@@ -0,0 +1,77 @@
+#ifndef GAMELOOP_INCLUDED
+#define GAMELOOP_INCLUDED
+
+#include "Board.h"
+#include "Game.h"
+#include "Player.h"
+#include "globals.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+
+// A quiet game loop specialized at compile time for two concrete strategy
+// types. When P1 and P2 are final classes the compiler can devirtualize and
+// inline every recommendAttack/recordAttackResult call, so simulation runs
+// don't pay for the Player vtable. Game::play stays the way to go for human
+// players, console output, salvos and mixed or unknown matchups.
+
+  // One turn: attacker shoots at target. Returns true if that won the game.
+template<class P>
+inline bool takeTurn(P& attacker, Board& target)
+{
+    bool shotHit, shipDestroyed;
+    int shipId;
+    Point p;
+    {
+        TRACE_SCOPE("recommendAttack", attacker.type());
+        PERF_SCOPE("recommendAttack", attacker.type());
+        p = attacker.recommendAttack();
+    }
+    bool validShot = target.attack(p, shotHit, shipDestroyed, shipId);
+    {
+        TRACE_SCOPE("recordAttackResult", attacker.type());
+        attacker.recordAttackResult(p, validShot, shotHit, shipDestroyed, shipId);
+    }
+    return target.allShipsDestroyed();
+}
+
+  // Same rules and turn order as a quiet Game::play on caller-owned boards
+template<class P1, class P2>
+Player* playStatic(P1& p1, P2& p2, Board& b1, Board& b2)
+{
+    TRACE_SCOPE("playStatic", "game");
+    // With no ships every board starts out destroyed; Game::play won't
+    // play that either
+    if (p1.game().nShips() == 0)
+        return nullptr;
+    b1.clear();
+    b2.clear();
+    p1.resetForNewGame();
+    p2.resetForNewGame();
+    {
+        TRACE_SCOPE("placeShips", p1.type());
+        PERF_SCOPE("placeShips", p1.type());
+        if (!p1.placeShips(b1))
+            return nullptr;
+    }
+    {
+        TRACE_SCOPE("placeShips", p2.type());
+        PERF_SCOPE("placeShips", p2.type());
+        if (!p2.placeShips(b2))
+            return nullptr;
+    }
+    for (;;)
+    {
+        if (takeTurn(p1, b2))
+            return &p1;
+        if (takeTurn(p2, b1))
+            return &p2;
+    }
+}
+
+  // Finds out which built-in strategies p1 and p2 are and runs the matching
+  // playStatic instantiation. Returns false (without playing) if either one
+  // isn't a computer strategy it knows; otherwise sets winner.
+bool playDevirtualized(Player* p1, Player* p2, Board& b1, Board& b2,
+                       Player*& winner);
+
+#endif // GAMELOOP_INCLUDED
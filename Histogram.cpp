@@ -0,0 +1,227 @@
+#include "Histogram.h"
+#include "Endian.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Every update below is a relaxed load followed by a relaxed store. That is
+// only correct because each histogram has a single writer; it's what keeps
+// record() free of locked instructions.
+namespace {
+
+inline void bump(atomic<uint64_t>& a, uint64_t by)
+{
+    a.store(a.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+inline void bump(atomic<double>& a, double by)
+{
+    a.store(a.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+void putDouble(ostream& out, double d)
+{
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    writeLE(out, v, 8);
+}
+
+bool getDouble(istream& in, double& d)
+{
+    uint64_t v;
+    if (!readLE(in, v, 8))
+        return false;
+    memcpy(&d, &v, sizeof(d));
+    return true;
+}
+
+} // namespace
+
+Histogram::Histogram()
+{
+    clear();
+}
+
+void Histogram::clear()
+{
+    for (int k = 0; k < NBUCKETS; k++)
+        m_buckets[k].store(0, memory_order_relaxed);
+    m_count.store(0, memory_order_relaxed);
+    m_min.store(UINT64_MAX, memory_order_relaxed);
+    m_max.store(0, memory_order_relaxed);
+    m_sum.store(0, memory_order_relaxed);
+    m_sumSquares.store(0, memory_order_relaxed);
+}
+
+int Histogram::bucketOf(uint64_t value)
+{
+    if (value < (uint64_t)SUB)
+        return (int)value;
+    // The top SUB_BITS bits below the leading one pick the bucket within the power of two
+    int e = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (e - SUB_BITS)) & (SUB - 1));
+    return SUB + (e - SUB_BITS) * SUB + sub;
+}
+
+uint64_t Histogram::bucketLow(int bucket)
+{
+    if (bucket < SUB)
+        return bucket;
+    int e = (bucket - SUB) / SUB + SUB_BITS;
+    uint64_t sub = (bucket - SUB) % SUB;
+    return (SUB + sub) << (e - SUB_BITS);
+}
+
+uint64_t Histogram::bucketWidth(int bucket)
+{
+    if (bucket < SUB)
+        return 1;
+    int e = (bucket - SUB) / SUB + SUB_BITS;
+    return uint64_t(1) << (e - SUB_BITS);
+}
+
+void Histogram::record(uint64_t value)
+{
+    bump(m_buckets[bucketOf(value)], 1);
+    bump(m_count, 1);
+    if (value < m_min.load(memory_order_relaxed))
+        m_min.store(value, memory_order_relaxed);
+    if (value > m_max.load(memory_order_relaxed))
+        m_max.store(value, memory_order_relaxed);
+    bump(m_sum, (double)value);
+    bump(m_sumSquares, (double)value * value);
+}
+
+void Histogram::merge(const Histogram& other)
+{
+    for (int k = 0; k < NBUCKETS; k++){
+        uint64_t n = other.m_buckets[k].load(memory_order_relaxed);
+        if (n != 0)
+            bump(m_buckets[k], n);
+    }
+    bump(m_count, other.m_count.load(memory_order_relaxed));
+    if (other.min() < min())
+        m_min.store(other.min(), memory_order_relaxed);
+    if (other.max() > max())
+        m_max.store(other.max(), memory_order_relaxed);
+    bump(m_sum, other.m_sum.load(memory_order_relaxed));
+    bump(m_sumSquares, other.m_sumSquares.load(memory_order_relaxed));
+}
+
+void Histogram::save(ostream& out) const
+{
+    uint64_t nonEmpty = 0;
+    for (int k = 0; k < NBUCKETS; k++)
+        if (m_buckets[k].load(memory_order_relaxed) != 0)
+            nonEmpty++;
+    writeLE(out, nonEmpty, 8);
+    for (int k = 0; k < NBUCKETS; k++){
+        uint64_t n = m_buckets[k].load(memory_order_relaxed);
+        if (n != 0){
+            writeLE(out, k, 8);
+            writeLE(out, n, 8);
+        }
+    }
+    writeLE(out, count(), 8);
+    writeLE(out, m_min.load(memory_order_relaxed), 8);
+    writeLE(out, max(), 8);
+    putDouble(out, m_sum.load(memory_order_relaxed));
+    putDouble(out, m_sumSquares.load(memory_order_relaxed));
+}
+
+bool Histogram::loadAndMerge(istream& in)
+{
+    uint64_t nonEmpty;
+    if (!readLE(in, nonEmpty, 8) || nonEmpty > (uint64_t)NBUCKETS)
+        return false;
+    for (uint64_t k = 0; k < nonEmpty; k++){
+        uint64_t bucket, n;
+        if (!readLE(in, bucket, 8) || !readLE(in, n, 8) || bucket >= (uint64_t)NBUCKETS)
+            return false;
+        bump(m_buckets[bucket], n);
+    }
+    uint64_t n, lo, hi;
+    double sum, sumSquares;
+    if (!readLE(in, n, 8) || !readLE(in, lo, 8) || !readLE(in, hi, 8) || !getDouble(in, sum) || !getDouble(in, sumSquares))
+        return false;
+    bump(m_count, n);
+    if (lo < m_min.load(memory_order_relaxed))
+        m_min.store(lo, memory_order_relaxed);
+    if (hi > m_max.load(memory_order_relaxed))
+        m_max.store(hi, memory_order_relaxed);
+    // The values recorded are whole numbers, so these sums stay exact (below 2^53)
+    // and come out the same whatever order histograms are merged in
+    bump(m_sum, sum);
+    bump(m_sumSquares, sumSquares);
+    return true;
+}
+
+uint64_t Histogram::count() const
+{
+    return m_count.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::min() const
+{
+    return count() == 0 ? 0 : m_min.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::max() const
+{
+    return m_max.load(memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    uint64_t n = count();
+    return n == 0 ? 0 : m_sum.load(memory_order_relaxed) / n;
+}
+
+double Histogram::stddev() const
+{
+    uint64_t n = count();
+    if (n < 2)
+        return 0;
+    double m = mean();
+    double var = (m_sumSquares.load(memory_order_relaxed) - n * m * m) / (n - 1);
+    return var > 0 ? sqrt(var) : 0;
+}
+
+double Histogram::confidence95() const
+{
+    uint64_t n = count();
+    return n < 2 ? 0 : 1.96 * stddev() / sqrt((double)n);
+}
+
+double Histogram::percentile(double p) const
+{
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+    if (p <= 0)
+        return (double)min();
+    if (p >= 1)
+        return (double)max();
+    // Walk the buckets to the one holding the p-th recording and interpolate inside it
+    double target = p * n;
+    double seen = 0;
+    for (int k = 0; k < NBUCKETS; k++){
+        uint64_t inBucket = m_buckets[k].load(memory_order_relaxed);
+        if (inBucket == 0)
+            continue;
+        if (seen + inBucket >= target){
+            double frac = (target - seen) / inBucket;
+            double v = bucketLow(k) + frac * bucketWidth(k);
+            // The exact extremes are known, so don't report past them
+            if (v < min())
+                v = (double)min();
+            if (v > max())
+                v = (double)max();
+            return v;
+        }
+        seen += inBucket;
+    }
+    return (double)max();
+}
@@ -0,0 +1,64 @@
+#ifndef HISTOGRAM_INCLUDED
+#define HISTOGRAM_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+// A log-linear histogram of non-negative integers: values below 16 get a
+// bucket each, and every power of two above that is split into 16 equal
+// buckets, so any recorded value is known to within about 6%.
+//
+// A Histogram is meant to have exactly one writer thread. record() is a
+// handful of relaxed loads and stores with no read-modify-write and no lock,
+// and other threads may read the histogram (or merge it into their own) at
+// any time; they see each bucket at some recent value. That lets every
+// worker keep its own histograms and have them combined only when somebody
+// wants a report.
+class Histogram
+{
+  public:
+    static const int SUB_BITS = 4;
+    static const int SUB = 1 << SUB_BITS;
+    static const int NBUCKETS = SUB + (64 - SUB_BITS) * SUB;
+
+    Histogram();
+    void clear();
+    void record(uint64_t value);
+      // Adds another histogram's counts to this one; only this histogram's writer may call it
+    void merge(const Histogram& other);
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    double stddev() const;
+      // Half-width of the 95% confidence interval of the mean (normal approximation)
+    double confidence95() const;
+      // Approximate value below which the fraction p (0..1) of the recordings fall
+    double percentile(double p) const;
+
+      // Compact binary form (only the non-empty buckets), for results files.
+      // loadAndMerge adds what it reads to this histogram and returns false
+      // if the stream doesn't hold a histogram.
+    void save(std::ostream& out) const;
+    bool loadAndMerge(std::istream& in);
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketLow(int bucket);
+    static uint64_t bucketWidth(int bucket);
+
+      // We prevent a Histogram object from being copied or assigned
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+  private:
+    std::atomic<uint64_t> m_buckets[NBUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+    std::atomic<double> m_sum;
+    std::atomic<double> m_sumSquares;
+};
+
+#endif // HISTOGRAM_INCLUDED
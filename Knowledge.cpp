@@ -0,0 +1,202 @@
+#include "Knowledge.h"
+#include "Game.h"
+
+using namespace std;
+
+Knowledge::Knowledge(const Game& g)
+ : m_game(g), m_masks(g.nShips()), m_ruledOut(g.nShips()), m_hitsOn(g.nShips()),
+   m_left(g.nShips()), m_sunk(g.nShips()), m_placed(g.nShips())
+{
+    for (int s = 0; s < g.nShips(); s++){
+        int len = g.shipLength(s);
+        for (int r = 0; r < g.rows(); r++)
+            for (int c = 0; c < g.cols(); c++){
+                if (c + len <= g.cols())
+                    m_masks[s].push_back(shipCells(Point(r, c), len, HORIZONTAL));
+                if (len > 1 && r + len <= g.rows())
+                    m_masks[s].push_back(shipCells(Point(r, c), len, VERTICAL));
+            }
+        for (size_t k = 0; k < m_masks[s].size(); k++){
+            Ref ref = { (short)s, (short)k };
+            for (Bitboard b = m_masks[s][k]; b.any(); )
+                m_byCell[b.popFirst()].push_back(ref);
+        }
+        m_ruledOut[s].resize(m_masks[s].size());
+        m_hitsOn[s].resize(m_masks[s].size());
+    }
+    reset();
+}
+
+void Knowledge::reset()
+{
+    m_misses = m_hits = m_owned = Bitboard();
+    for (int i = 0; i < MAXROWS * MAXCOLS; i++){
+        m_cover[i] = (int)m_byCell[i].size();
+        m_coverHit[i] = 0;
+        m_owner[i] = -1;
+    }
+    for (int s = 0; s < m_game.nShips(); s++){
+        m_ruledOut[s].assign(m_masks[s].size(), 0);
+        m_hitsOn[s].assign(m_masks[s].size(), 0);
+        m_left[s] = (int)m_masks[s].size();
+        m_sunk[s] = false;
+        m_placed[s] = false;
+    }
+}
+
+// Takes a placement of a ship still afloat out of the counts
+void Knowledge::uncount(int ship, int k)
+{
+    bool throughHit = m_hitsOn[ship][k] > 0;
+    for (Bitboard b = m_masks[ship][k]; b.any(); ){
+        int i = b.popFirst();
+        m_cover[i]--;
+        if (throughHit)
+            m_coverHit[i]--;
+    }
+}
+
+void Knowledge::rule(int ship, int k)
+{
+    if (m_ruledOut[ship][k])
+        return;
+    m_ruledOut[ship][k] = 1;
+    m_left[ship]--;
+    if (!m_sunk[ship])
+        uncount(ship, k);
+}
+
+void Knowledge::record(Point p, bool shotHit, bool shipDestroyed, int shipId)
+{
+    int cell = Bitboard::index(p.r, p.c);
+    if ((m_misses | m_hits).testBit(cell))
+        return;
+    const vector<Ref>& through = m_byCell[cell];
+
+    if (!shotHit){
+        m_misses |= Bitboard::bit(cell);
+        for (size_t j = 0; j < through.size(); j++)
+            rule(through[j].ship, through[j].k);
+        return;
+    }
+
+    m_hits |= Bitboard::bit(cell);
+    bool sinking = shipDestroyed && shipId >= 0 && shipId < m_game.nShips() && !m_sunk[shipId];
+    if (sinking){
+        // A sunk ship's placements no longer count as somewhere to shoot
+        m_sunk[shipId] = true;
+        for (size_t k = 0; k < m_masks[shipId].size(); k++)
+            if (!m_ruledOut[shipId][k])
+                uncount(shipId, (int)k);
+    }
+
+    for (size_t j = 0; j < through.size(); j++){
+        int s = through[j].ship;
+        int k = through[j].k;
+        if (m_ruledOut[s][k])
+            continue;
+        int hits = ++m_hitsOn[s][k];
+        if (m_sunk[s])
+            continue;
+        // Counted as through a hit first, since ruling it out uncounts it
+        // that way -- a one-cell ship gets both on the same shot
+        if (hits == 1)
+            for (Bitboard b = m_masks[s][k]; b.any(); )
+                m_coverHit[b.popFirst()]++;
+        if (hits == m_game.shipLength(s))
+            rule(s, k);     // it would have been sunk
+    }
+
+    if (sinking){
+        // The ship that just went down is all hits, one of them this one
+        int len = m_game.shipLength(shipId);
+        for (size_t k = 0; k < m_masks[shipId].size(); k++)
+            if (!m_masks[shipId][k].testBit(cell) || m_hitsOn[shipId][k] < len)
+                rule(shipId, (int)k);
+        propagate();
+    }
+}
+
+void Knowledge::propagate()
+{
+    // Pin down every sunk ship with one placement left; that can leave
+    // another with only one, so keep going until nothing changes
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int s = 0; s < m_game.nShips(); s++){
+            if (!m_sunk[s] || m_placed[s] || m_left[s] > 1)
+                continue;
+            m_placed[s] = true;
+            if (m_left[s] == 0)     // the sink notices contradict each other
+                continue;
+            int k = 0;
+            while (m_ruledOut[s][k])
+                k++;
+            Bitboard cells = m_masks[s][k];
+            m_owned |= cells;
+            for (Bitboard b = cells; b.any(); ){
+                int i = b.popFirst();
+                m_owner[i] = (signed char)s;
+                for (size_t j = 0; j < m_byCell[i].size(); j++)
+                    if (m_byCell[i][j].ship != s)
+                        rule(m_byCell[i][j].ship, m_byCell[i][j].k);
+            }
+            changed = true;
+        }
+    }
+}
+
+bool Knowledge::openHit(Point p) const
+{
+    int i = Bitboard::index(p.r, p.c);
+    return m_hits.testBit(i) && !m_owned.testBit(i) && m_cover[i] > 0;
+}
+
+bool Knowledge::openHits() const
+{
+    for (Bitboard b = m_hits.andNot(m_owned); b.any(); )
+        if (m_cover[b.popFirst()] > 0)
+            return true;
+    return false;
+}
+
+bool Knowledge::bestTarget(Point& p) const
+{
+    Bitboard untried = Bitboard::full(m_game.rows(), m_game.cols()).andNot(m_misses | m_hits);
+    if (untried.empty())
+        return false;
+    const int* score = m_coverHit;
+    bool chasing = false;
+    for (Bitboard b = untried; b.any() && !chasing; )
+        chasing = m_coverHit[b.popFirst()] > 0;
+    if (!chasing)
+        score = m_cover;
+    int best = untried.first();
+    for (Bitboard b = untried; b.any(); ){
+        int i = b.popFirst();
+        if (score[i] > score[best])
+            best = i;
+    }
+    p = Point(best / MAXCOLS, best % MAXCOLS);
+    return true;
+}
+
+// Sink a ship in a corner and see the engine place it
+/*
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    Knowledge k(g);
+    k.record(Point(0,0), true, false, 4);
+    k.record(Point(1,0), false, false, -1);
+    k.record(Point(0,1), true, true, 4);
+    cout << "owner of (0,1): " << k.owner(Point(0,1)) << endl;
+    cout << "placements through (5,5): " << k.placements(Point(5,5)) << endl;
+    Point p;
+    k.bestTarget(p);
+    cout << "next shot (" << p.r << "," << p.c << ")" << endl;
+}
+*/
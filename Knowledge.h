@@ -0,0 +1,87 @@
+#ifndef KNOWLEDGE_INCLUDED
+#define KNOWLEDGE_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include <vector>
+
+class Game;
+
+// What the shots fired so far say about where the opponent's ships can be.
+// Every placement of every ship starts out possible; each shot rules some
+// out:
+//   - a miss rules out every placement through it
+//   - a ship that hasn't been sunk can't be lying entirely on hits
+//   - a sunk ship lies entirely on hits, through the shot that sank it
+// When only one placement is left for a sunk ship its cells are known to be
+// that ship's, which rules out every other ship's placements through them,
+// which can pin down another sunk ship, and so on.
+//
+// Every shot only touches the placements through its cell, and the per-cell
+// counts are kept up to date as placements are ruled out, so asking about a
+// cell is a lookup. Nothing is allocated after construction.
+
+class Knowledge
+{
+  public:
+    Knowledge(const Game& g);
+      // Forget every shot (for a new game)
+    void reset();
+      // The result of one valid shot, as passed to Player::recordAttackResult
+    void record(Point p, bool shotHit, bool shipDestroyed, int shipId);
+
+      // How many possible placements of ships still afloat cover the cell
+    int placements(Point p) const { return m_cover[Bitboard::index(p.r, p.c)]; }
+      // How many of those also go through a hit not known to be a sunk ship's
+    int hitPlacements(Point p) const { return m_coverHit[Bitboard::index(p.r, p.c)]; }
+    bool tried(Point p) const { return (m_misses | m_hits).test(p.r, p.c); }
+      // The sunk ship known to be on the cell, or -1
+    int owner(Point p) const { return m_owner[Bitboard::index(p.r, p.c)]; }
+    bool sunk(int shipId) const { return m_sunk[shipId]; }
+      // Whether a hit might still belong to a ship that's afloat -- that is,
+      // whether there's something to chase
+    bool openHits() const;
+      // Whether the cell is one of those hits
+    bool openHit(Point p) const;
+    Bitboard misses() const { return m_misses; }
+    Bitboard hits() const { return m_hits; }
+      // Every placement of a ship, by number, and whether it's still possible
+    int nPlacements(int shipId) const { return (int)m_masks[shipId].size(); }
+    Bitboard placement(int shipId, int k) const { return m_masks[shipId][k]; }
+    bool possible(int shipId, int k) const { return !m_ruledOut[shipId][k]; }
+      // The untried cell most likely to hold a ship: the one with the most
+      // placements through open hits if there are any, else the one with
+      // the most placements. False once every cell has been tried.
+    bool bestTarget(Point& p) const;
+      // We prevent a Knowledge object from being copied or assigned
+    Knowledge(const Knowledge&) = delete;
+    Knowledge& operator=(const Knowledge&) = delete;
+
+  private:
+    struct Ref
+    {
+        short ship;
+        short k;
+    };
+
+    void rule(int ship, int k);
+    void uncount(int ship, int k);
+    void propagate();
+
+    const Game& m_game;
+    std::vector<std::vector<Bitboard> > m_masks;         // by ship, every placement
+    std::vector<Ref> m_byCell[MAXROWS * MAXCOLS];        // placements through each cell
+    std::vector<std::vector<char> > m_ruledOut;          // by ship and placement
+    std::vector<std::vector<unsigned char> > m_hitsOn;   // hits under each placement
+    std::vector<int> m_left;                             // possible placements by ship
+    std::vector<bool> m_sunk;
+    std::vector<bool> m_placed;                          // sunk and pinned down
+    int m_cover[MAXROWS * MAXCOLS];
+    int m_coverHit[MAXROWS * MAXCOLS];
+    signed char m_owner[MAXROWS * MAXCOLS];
+    Bitboard m_misses;
+    Bitboard m_hits;
+    Bitboard m_owned;
+};
+
+#endif // KNOWLEDGE_INCLUDED
@@ -0,0 +1,395 @@
+#include "Learned.h"
+#include "Dataset.h"
+#include "Game.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Learned from 20000 games of good against itself: four passes at a rate of
+// 0.01 (see the example at the end of this file). Kernel by channel and
+// row, then the bias by row.
+const float BUILT_IN[] = {
+    -0.013187, -0.077884, 0.0006293, -0.30407, -0.10782, -0.028267, -0.018582,
+    -0.016984, -0.071234, -0.1231, -0.14264, -0.19903, 0.081149, -0.15989,
+    0.11585, -0.1464, -0.019295, -0.27946, -0.032483, -0.12937, 0.029757,
+    -0.16708, -0.14551, -0.4173, 0, -0.41502, -0.39441, -0.042194,
+    0.11791, -0.062495, 0.20076, -0.34324, 0.099371, -0.098339, -0.1079,
+    -0.0023594, 0.13418, -0.24465, -0.209, -0.15348, 0.087207, -0.13005,
+    0.069524, -0.014733, 0.10955, -0.11142, -0.053126, -0.06476, 0.046871,
+    -0.17827, 0.050644, 0.21512, -0.41198, 0.30513, 0.13855, -0.11501,
+    0.1303, -1.1115, -1.0751, 3.2228, -1.0432, -0.92174, 0.098435,
+    0.35285, -0.78616, -7.296, 10.126, -7.6122, 0.58938, -0.47925,
+    -0.20124, 3.4136, 10.102, 0, 9.902, -1.1156, 0.81368,
+    0.53011, -1.0633, -7.1964, 9.8315, -7.7982, 0.95455, -0.52938,
+    0.13994, -0.74707, 0.50073, -1.1875, 0.83524, -0.36006, 0.32685,
+    -0.094168, 0.099019, -0.57645, 0.79392, -0.50656, 0.24466, -0.00061083,
+    -0.013588, -0.0080495, 0.10959, -0.069217, 0.010152, -0.19814, 0.03521,
+    0.023349, -0.042798, 0.026919, 0.084807, 0.034612, 0.090888, 0.10866,
+    0.056341, -0.17235, -0.17843, -0.033756, -0.20435, 0.08567, -0.002186,
+    0.029921, 0.083947, -0.052415, 0, -0.035471, -0.20262, 0.041185,
+    0.039567, 0.0074979, -0.20912, 0.075688, -0.177, -0.090158, 0.036407,
+    -0.14069, -0.15426, 0.080243, -0.26835, 0.02503, -0.062418, 0.08945,
+    0.045204, 0.041973, -0.064296, 0.17703, 0.11064, 0.070643, -0.070816,
+    -0.35288, 0.45173, -0.56131, -0.063571, 0.59372, -0.36822, 0.33046,
+    0.37784, -0.012611, 0.59222, -0.068991, -0.59575, 0.038713, -0.38801,
+    -0.7083, 0.46256, -0.86845, -0.080157, 0.85841, -0.546, 0.6293,
+    -0.10787, -0.048679, -0.0078282, 0, -0.11987, -0.022154, -0.055822,
+    0.60658, -0.53763, 0.9097, -0.16429, -1.0181, 0.45161, -0.65494,
+    -0.4104, 0.0096108, -0.55632, -0.080807, 0.49727, -0.069545, 0.32931,
+    0.33112, -0.41309, 0.6094, 0.0020749, -0.55279, 0.4064, -0.35731,
+    0.81422, -1.3758, 1.1444, -1.5174, 1.6081, -1.6127, 1.5889, -1.1763, 1.4988, -1.0236,
+    -1.4524, 1.9202, -1.5728, 1.6692, -1.5572, 1.4877, -1.4507, 1.5903, -2.0554, 1.4684,
+    1.1901, -1.6281, 1.1825, -1.6162, 1.5162, -1.4764, 1.5705, -1.1379, 1.5941, -1.16,
+    -1.666, 1.6444, -1.5757, 1.5062, -1.4802, 1.4216, -1.4499, 1.4841, -1.5673, 1.5023,
+    1.6724, -1.4531, 1.4851, -1.545, 1.5938, -1.5445, 1.5194, -1.5346, 1.5862, -1.4983,
+    -1.5673, 1.5978, -1.5071, 1.42, -1.5212, 1.4418, -1.4257, 1.512, -1.5511, 1.7142,
+    1.5832, -1.6683, 1.6072, -1.5026, 1.3954, -1.4124, 1.523, -1.4801, 1.5206, -1.5912,
+    -1.0554, 1.5816, -1.1758, 1.4467, -1.5752, 1.5725, -1.4602, 1.1521, -1.5351, 1.1629,
+    1.5471, -2.0253, 1.5542, -1.4828, 1.416, -1.4601, 1.5038, -1.5302, 2.0347, -1.4371,
+    -1.0446, 1.4021, -1.1724, 1.6611, -1.6336, 1.7973, -1.6433, 1.1181, -1.3906, 0.77123,
+};
+
+mutex defaultMutex;
+CellModel* defaultModelPtr = nullptr;   // null means the built-in model
+
+// The channel of a cell seen as state, or -1 if nothing's known of it
+int channelOf(int state)
+{
+    switch (state)
+    {
+      case MISS:  return CellModel::MISS_CELLS;
+      case HIT:   return CellModel::HIT_CELLS;
+      case SUNK:  return CellModel::SUNK_CELLS;
+      default:    return -1;
+    }
+}
+
+// dst[0..n) += src[0..n); n is a multiple of 4 and src is aligned
+void addTo(float* dst, const float* src, int n)
+{
+#ifdef __SSE2__
+    for (int j = 0; j < n; j += 4)
+        _mm_storeu_ps(dst + j, _mm_add_ps(_mm_loadu_ps(dst + j), _mm_load_ps(src + j)));
+#else
+    for (int j = 0; j < n; j++)
+        dst[j] += src[j];
+#endif
+}
+
+} // namespace
+
+//*********************************************************************
+//  CellModel
+//*********************************************************************
+
+CellModel::CellModel()
+{
+    memset(m_kernel, 0, sizeof(m_kernel));
+    memset(m_bias, 0, sizeof(m_bias));
+}
+
+const CellModel& CellModel::builtIn()
+{
+    static CellModel m = []{
+        CellModel b;
+        const float* w = BUILT_IN;
+        for (int ch = 0; ch < CHANNELS; ch++)
+            for (int a = 0; a < WIDTH; a++)
+                for (int j = 0; j < WIDTH; j++)
+                    b.m_kernel[ch][a][j] = *w++;
+        for (int r = 0; r < MAXROWS; r++)
+            for (int c = 0; c < MAXCOLS; c++)
+                b.m_bias[r][c] = *w++;
+        return b;
+    }();
+    return m;
+}
+
+bool CellModel::load(const string& path)
+{
+    ifstream in(path.c_str());
+    string tag;
+    int radius;
+    if (!(in >> tag >> radius) || tag != "cellmodel" || radius != RADIUS)
+        return false;
+    CellModel m;
+    for (int ch = 0; ch < CHANNELS; ch++)
+        for (int a = 0; a < WIDTH; a++)
+            for (int j = 0; j < WIDTH; j++)
+                in >> m.m_kernel[ch][a][j];
+    for (int r = 0; r < MAXROWS; r++)
+        for (int c = 0; c < MAXCOLS; c++)
+            in >> m.m_bias[r][c];
+    if (!in)
+        return false;
+    *this = m;
+    return true;
+}
+
+bool CellModel::save(const string& path) const
+{
+    ofstream out(path.c_str());
+    out << "cellmodel " << RADIUS << endl;
+    out.precision(6);
+    for (int ch = 0; ch < CHANNELS; ch++)
+        for (int a = 0; a < WIDTH; a++)
+            for (int j = 0; j < WIDTH; j++)
+                out << m_kernel[ch][a][j] << (j + 1 < WIDTH ? " " : "\n");
+    for (int r = 0; r < MAXROWS; r++)
+        for (int c = 0; c < MAXCOLS; c++)
+            out << m_bias[r][c] << (c + 1 < MAXCOLS ? " " : "\n");
+    return bool(out);
+}
+
+double CellModel::train(DatasetReader& data, double rate)
+{
+    int rows = data.rows();
+    int cols = data.cols();
+    if (rows > MAXROWS || cols > MAXCOLS)
+        return 0;
+    uint8_t seen[MAXROWS * MAXCOLS];
+    double score[MAXROWS * MAXCOLS];
+    double loss = 0;
+    long long n = 0;
+    for (int k = 0; k < data.nChunks(); k++){
+        int nRows = data.loadChunk(k);
+        for (int row = 0; row < nRows; row++){
+            if (!data.won(row))
+                continue;
+            for (int r = 0; r < rows; r++)
+                for (int c = 0; c < cols; c++)
+                    seen[r * cols + c] = (uint8_t)data.state(row, r, c);
+            Point chosen = data.chosen(row);
+            int target = chosen.r * cols + chosen.c;
+            if (seen[target] != UNKNOWN)
+                continue;
+
+            // Softmax over the untried cells
+            double top = -1e30;
+            for (int r = 0; r < rows; r++)
+                for (int c = 0; c < cols; c++){
+                    if (seen[r * cols + c] != UNKNOWN)
+                        continue;
+                    double s = m_bias[r][c];
+                    for (int dr = -RADIUS; dr <= RADIUS; dr++)
+                        for (int dc = -RADIUS; dc <= RADIUS; dc++){
+                            int rr = r + dr, cc = c + dc;
+                            int ch = rr < 0 || rr >= rows || cc < 0 || cc >= cols ? OFF_BOARD
+                                                                            : channelOf(seen[rr * cols + cc]);
+                            if (ch >= 0)
+                                s += m_kernel[ch][RADIUS + dr][RADIUS + dc];
+                        }
+                    score[r * cols + c] = s;
+                    top = max(top, s);
+                }
+            double total = 0;
+            for (int i = 0; i < rows * cols; i++)
+                if (seen[i] == UNKNOWN){
+                    score[i] = exp(score[i] - top);
+                    total += score[i];
+                }
+            loss -= log(score[target] / total);
+            n++;
+
+            // Down the gradient: every cell's share of the blame is its
+            // probability, less 1 for the one the winner picked
+            for (int r = 0; r < rows; r++)
+                for (int c = 0; c < cols; c++){
+                    int i = r * cols + c;
+                    if (seen[i] != UNKNOWN)
+                        continue;
+                    float step = (float)(rate * (score[i] / total - (i == target)));
+                    m_bias[r][c] -= step;
+                    for (int dr = -RADIUS; dr <= RADIUS; dr++)
+                        for (int dc = -RADIUS; dc <= RADIUS; dc++){
+                            int rr = r + dr, cc = c + dc;
+                            int ch = rr < 0 || rr >= rows || cc < 0 || cc >= cols ? OFF_BOARD
+                                                                            : channelOf(seen[rr * cols + cc]);
+                            if (ch >= 0)
+                                m_kernel[ch][RADIUS + dr][RADIUS + dc] -= step;
+                        }
+                }
+        }
+    }
+    return n == 0 ? 0 : loss / n;
+}
+
+//*********************************************************************
+//  CellScorer
+//*********************************************************************
+
+CellScorer::CellScorer(const CellModel& m, int rows, int cols)
+ : m_rows(rows), m_cols(cols)
+{
+    const int R = CellModel::RADIUS;
+    memset(m_kernel, 0, sizeof(m_kernel));
+    for (int ch = 0; ch < CellModel::OFF_BOARD; ch++)
+        for (int a = 0; a < CellModel::WIDTH; a++)
+            for (int j = 0; j < CellModel::WIDTH; j++)
+                m_kernel[ch][a][j] = m.weight(ch, a - R, R - j);
+
+    // The bias, and the edges, which are where they are all game
+    memset(m_start, 0, sizeof(m_start));
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++){
+            float s = m.bias(r, c);
+            for (int dr = -R; dr <= R; dr++)
+                for (int dc = -R; dc <= R; dc++)
+                    if (r + dr < 0 || r + dr >= rows || c + dc < 0 || c + dc >= cols)
+                        s += m.weight(CellModel::OFF_BOARD, dr, dc);
+            m_start[(r + R) * STRIDE + c + R] = s;
+        }
+    memcpy(m_grid, m_start, sizeof(m_grid));
+}
+
+void CellScorer::run(const uint8_t* seen)
+{
+    memcpy(m_grid, m_start, sizeof(m_grid));
+    for (int r = 0; r < m_rows; r++)
+        for (int c = 0; c < m_cols; c++){
+            int ch = channelOf(seen[r * m_cols + c]);
+            if (ch < 0)
+                continue;
+            for (int a = 0; a < CellModel::WIDTH; a++)
+                addTo(&m_grid[(r + 2 * CellModel::RADIUS - a) * STRIDE + c], m_kernel[ch][a], SPAN);
+        }
+}
+
+//*********************************************************************
+//  LearnedPlayer
+//*********************************************************************
+
+LearnedPlayer::LearnedPlayer(string nm, const Game& g, const CellModel& m)
+ : Player(nm, g), m_scorer(m, g.rows(), g.cols()), m_knowledge(g), m_placer(g)
+{
+    resetForNewGame();
+}
+
+void LearnedPlayer::setDefaultModel(const CellModel& m)
+{
+    lock_guard<mutex> lock(defaultMutex);
+    if (defaultModelPtr == nullptr)
+        defaultModelPtr = new CellModel;
+    *defaultModelPtr = m;
+}
+
+CellModel LearnedPlayer::defaultModel()
+{
+    lock_guard<mutex> lock(defaultMutex);
+    return defaultModelPtr == nullptr ? CellModel::builtIn() : *defaultModelPtr;
+}
+
+bool LearnedPlayer::placeShips(Board& b)
+{
+    return m_placer.place(b);
+}
+
+Point LearnedPlayer::recommendAttack()
+{
+    if (m_untried.empty())
+        return Point(0, 0);
+    m_scorer.run(m_seen);
+    // A cell no ship can be on is only worth it when there's nothing else
+    int best = -1;
+    float bestScore = 0;
+    bool bestPossible = false;
+    for (Bitboard b = m_untried; b.any(); ){
+        int i = b.popFirst();
+        int r = i / MAXCOLS, c = i % MAXCOLS;
+        bool possible = m_knowledge.placements(Point(r, c)) > 0;
+        float s = m_scorer.score(r, c);
+        if (best == -1 || (possible && !bestPossible) || (possible == bestPossible && s > bestScore)){
+            best = i;
+            bestScore = s;
+            bestPossible = possible;
+        }
+    }
+    return Point(best / MAXCOLS, best % MAXCOLS);
+}
+
+void LearnedPlayer::recordAttackResult(Point p, bool validShot, bool shotHit,
+                                       bool shipDestroyed, int shipId)
+{
+    if (!validShot)
+        return;
+    m_knowledge.record(p, shotHit, shipDestroyed, shipId);
+    m_untried.reset(p.r, p.c);
+    // What the training data would have shown
+    const Game& g = game();
+    m_seen[p.r * g.cols() + p.c] = shotHit ? HIT : MISS;
+    if (shotHit && shipDestroyed && shipId >= 0 && shipId < g.nShips())
+        markSunk(m_seen, g.rows(), g.cols(), p.r, p.c, g.shipLength(shipId));
+}
+
+void LearnedPlayer::recordAttackByOpponent(Point /* p */)
+{
+      // The model only looks at the opponent's board
+}
+
+void LearnedPlayer::recordShotPending(Point p)
+{
+    // The scores don't change until the results are in, so without this
+    // every shot of a salvo would be the same cell
+    m_untried.reset(p.r, p.c);
+}
+
+void LearnedPlayer::resetForNewGame()
+{
+    m_knowledge.reset();
+    m_untried = Bitboard::full(game().rows(), game().cols());
+    memset(m_seen, UNKNOWN, sizeof(m_seen));
+}
+
+// Training a model from self-play and pitting it against good
+/*
+#include "Board.h"
+#include "GameLog.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    {
+        DatasetWriter data(g, "selfplay.bsds");
+        {
+            LogWriter w(data);
+            Player* p1 = createPlayer("good", "g1", g);
+            Player* p2 = createPlayer("good", "g2", g);
+            Board b1(g), b2(g);
+            PlayOptions opts;
+            opts.quiet = true;
+            opts.log = w.producer();
+            for (int k = 0; k < 20000; k++)
+                g.play(p1, p2, b1, b2, opts);
+            delete p1;
+            delete p2;
+        }
+        data.close();
+    }
+    DatasetReader in("selfplay.bsds");
+    CellModel m;
+    for (int pass = 0; pass < 4; pass++)
+        cout << "pass " << pass << ": log loss " << m.train(in, 0.01) << endl;
+    m.save("cellmodel.txt");
+
+    LearnedPlayer learned("learned", g, m);
+    Player* good = createPlayer("good", "good", g);
+    PlayOptions opts;
+    opts.quiet = true;
+    int wins = 0;
+    for (int k = 0; k < 1000; k++)
+        wins += g.play(k % 2 ? good : (Player*)&learned, k % 2 ? (Player*)&learned : good, opts) == &learned;
+    cout << "learned won " << wins << " of 1000 against good" << endl;
+    delete good;
+}
+*/
@@ -0,0 +1,111 @@
+#ifndef LEARNED_INCLUDED
+#define LEARNED_INCLUDED
+
+#include "Player.h"
+#include "globals.h"
+#include "Bitboard.h"
+#include "Knowledge.h"
+#include "PlacementSampler.h"
+#include <cstdint>
+#include <string>
+
+class DatasetReader;
+
+// A small learned model of where to shoot: one convolution over what's
+// known of the opponent's board. Each cell's score is its own bias plus a
+// weight for every miss, hit, sunk cell and edge of the board within
+// RADIUS of it, by where that is relative to the cell. The weights are
+// learned from self-play (see Dataset.h) by imitating the winners: train
+// nudges them so the cell the winner fired at scores highest among the
+// untried ones.
+
+class CellModel
+{
+  public:
+    enum { RADIUS = 3, WIDTH = 2 * RADIUS + 1 };
+    enum Channel { MISS_CELLS, HIT_CELLS, SUNK_CELLS, OFF_BOARD, CHANNELS };
+
+      // All weights 0
+    CellModel();
+      // The weights that come with the program
+    static const CellModel& builtIn();
+      // A text file of the weights; false (leaving the model as it was) if
+      // it can't be read
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+      // One pass over every winning shot in the data; returns the average
+      // log loss, how surprised the model was by the winners' shots
+    double train(DatasetReader& data, double rate);
+
+      // Weight of a cell in the channel at (dr,dc) from the cell being scored
+    float weight(int channel, int dr, int dc) const { return m_kernel[channel][RADIUS + dr][RADIUS + dc]; }
+    float bias(int r, int c) const { return m_bias[r][c]; }
+
+  private:
+    float m_kernel[CHANNELS][WIDTH][WIDTH];
+    float m_bias[MAXROWS][MAXCOLS];
+};
+
+// A CellModel set up for fast scoring on one size of board. Rather than
+// gather a window around every cell, each known cell adds its weights into
+// a padded grid of scores, one row of the kernel at a time, with SSE2 where
+// the compiler has it. The bias and the board's edges don't change during a
+// game, so they're worked into the starting grid up front.
+
+class CellScorer
+{
+  public:
+    CellScorer(const CellModel& m, int rows, int cols);
+      // Scores every cell of seen (a CellKnowledge for each cell r * cols + c);
+      // read them with score
+    void run(const uint8_t* seen);
+    float score(int r, int c) const { return m_grid[(r + CellModel::RADIUS) * STRIDE + c + CellModel::RADIUS]; }
+
+  private:
+    enum {
+        STRIDE = (MAXCOLS + 2 * CellModel::RADIUS + 3) / 4 * 4,
+        GRID_ROWS = MAXROWS + 2 * CellModel::RADIUS,
+        SPAN = (CellModel::WIDTH + 3) / 4 * 4     // a kernel row, padded to whole vectors
+    };
+
+    int m_rows;
+    int m_cols;
+      // The kernel's rows, flipped, so a known cell at (r,c) adds row a into
+      // the grid row r + 2 * RADIUS - a, starting at column c
+    alignas(16) float m_kernel[CellModel::OFF_BOARD][CellModel::WIDTH][SPAN];
+    alignas(16) float m_start[GRID_ROWS * STRIDE + SPAN];
+    alignas(16) float m_grid[GRID_ROWS * STRIDE + SPAN];
+};
+
+// Fires at the untried cell a CellModel scores highest, skipping cells
+// Knowledge says no ship can be on. createPlayer's "learned" uses the
+// default model; see setDefaultModel.
+
+class LearnedPlayer : public Player
+{
+  public:
+    LearnedPlayer(std::string nm, const Game& g, const CellModel& m);
+    virtual const char* type() const { return "learned"; }
+    virtual bool placeShips(Board& b);
+    virtual Point recommendAttack();
+    virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
+                                        bool shipDestroyed, int shipId);
+    virtual void recordAttackByOpponent(Point p);
+    virtual void recordShotPending(Point p);
+    virtual void resetForNewGame();
+
+      // The model of every "learned" player createPlayer makes from now on
+      // (the built-in one until this is called)
+    static void setDefaultModel(const CellModel& m);
+    static CellModel defaultModel();
+
+  private:
+    CellScorer m_scorer;
+    Knowledge m_knowledge;
+    PlacementSampler m_placer;
+    Bitboard m_untried;
+    uint8_t m_seen[MAXROWS * MAXCOLS];
+};
+
+#endif // LEARNED_INCLUDED
@@ -0,0 +1,208 @@
+#include "LockstepEngine.h"
+#include "Game.h"
+#include "Bitboard.h"
+#include "globals.h"
+
+using namespace std;
+
+LockstepEngine::LockstepEngine(const Game& g)
+ : m_game(g), m_full(Bitboard::full(g.rows(), g.cols()))
+{
+    for (int r = 0; r < m_game.rows(); r++)
+        for (int c = r % 2; c < m_game.cols(); c += 2)
+            m_even.set(r, c);
+}
+
+bool LockstepEngine::placeRandomly(Fleet& f, int lane)
+{
+    // Drop the ships one at a time at random spots; if we paint ourselves into a corner start the fleet over
+    for (int attempt = 0; attempt < 100; attempt++){
+        Bitboard used;
+        int s = 0;
+        for (; s < m_game.nShips(); s++){
+            int len = m_game.shipLength(s);
+            int tries = 0;
+            for (; tries < 100; tries++){
+                Direction dir = randInt(2) == 0 ? HORIZONTAL : VERTICAL;
+                int maxR = dir == VERTICAL ? m_game.rows() - len + 1 : m_game.rows();
+                int maxC = dir == HORIZONTAL ? m_game.cols() - len + 1 : m_game.cols();
+                if (maxR < 1 || maxC < 1)
+                    continue;
+                Bitboard cells = shipCells(Point(randInt(maxR), randInt(maxC)), len, dir);
+                if (cells.intersects(used))
+                    continue;
+                used |= cells;
+                f.shipLo[s][lane] = cells.lo();
+                f.shipHi[s][lane] = cells.hi();
+                break;
+            }
+            if (tries == 100)
+                break;
+        }
+        if (s == m_game.nShips())
+            return true;
+    }
+    return false;
+}
+
+bool LockstepEngine::place(Strategy s, Fleet& f)
+{
+    int total = 0;
+    for (int k = 0; k < m_game.nShips(); k++)
+        total += m_game.shipLength(k);
+
+    for (int lane = 0; lane < LANES; lane++){
+        if (s == AWFUL){
+            // Clustered in the top left corner, exactly like AwfulPlayer::placeShips
+            for (int k = 0; k < m_game.nShips(); k++){
+                if (k >= m_game.rows() || m_game.shipLength(k) > m_game.cols())
+                    return false;
+                Bitboard cells = shipCells(Point(k, 0), m_game.shipLength(k), HORIZONTAL);
+                f.shipLo[k][lane] = cells.lo();
+                f.shipHi[k][lane] = cells.hi();
+            }
+        }
+        else if (!placeRandomly(f, lane))
+            return false;
+        f.alive[lane] = total;
+    }
+    return true;
+}
+
+void LockstepEngine::chooseShots(Strategy s, Shooter& me, const uint8_t active[LANES], int cell[LANES])
+{
+    int nCells = m_game.rows() * m_game.cols();
+    for (int lane = 0; lane < LANES; lane++){
+        cell[lane] = 0;
+        if (!active[lane])
+            continue;
+
+        if (s == AWFUL){
+            // AwfulPlayer sweeps backwards from the bottom right corner, wrapping around
+            int n = nCells - 1 - me.nShots[lane] % nCells;
+            cell[lane] = Bitboard::index(n / m_game.cols(), n % m_game.cols());
+            continue;
+        }
+
+        Bitboard shot(me.shotLo[lane], me.shotHi[lane]);
+        // Target mode: work through the queued neighbours of earlier hits
+        bool found = false;
+        while (!found && me.queueSize[lane] > 0){
+            int i = me.queue[lane][--me.queueSize[lane]];
+            if (!shot.testBit(i)){
+                cell[lane] = i;
+                found = true;
+            }
+        }
+        if (found)
+            continue;
+
+        // Hunt mode: a random untried cell of the checkerboard, or any untried cell once that's used up
+        Bitboard untried = m_full.andNot(shot);
+        Bitboard candidates = untried & m_even;
+        if (candidates.empty())
+            candidates = untried;
+        int n = randInt(candidates.count());
+        while (n-- > 0)
+            candidates.popFirst();
+        cell[lane] = candidates.first();
+    }
+}
+
+void LockstepEngine::fire(const int cell[LANES], const uint8_t active[LANES], Shooter& me, Fleet& them,
+                          uint8_t hit[LANES])
+{
+    // From here on everything is a loop across the lanes with no lane-dependent control flow
+    uint64_t lo[LANES], hi[LANES];
+    for (int k = 0; k < LANES; k++){
+        uint64_t on = 0 - (uint64_t)active[k];
+        int i = cell[k];
+        lo[k] = (i < 64 ? uint64_t(1) << (i & 63) : 0) & on;
+        hi[k] = (i >= 64 ? uint64_t(1) << (i & 63) : 0) & on;
+        // A repeat shot can't hit anything
+        lo[k] &= ~me.shotLo[k];
+        hi[k] &= ~me.shotHi[k];
+        me.shotLo[k] |= lo[k];
+        me.shotHi[k] |= hi[k];
+        me.nShots[k] += active[k];
+        hit[k] = 0;
+    }
+    // Hit detection; neither strategy here does anything different on a
+    // sink, so there's no need to tell which ship it was
+    for (int s = 0; s < m_game.nShips(); s++)
+        for (int k = 0; k < LANES; k++)
+            hit[k] |= ((lo[k] & them.shipLo[s][k]) | (hi[k] & them.shipHi[s][k])) != 0;
+    // Win detection
+    for (int k = 0; k < LANES; k++)
+        them.alive[k] -= hit[k];
+}
+
+void LockstepEngine::learn(Strategy s, Shooter& me, const int cell[LANES], const uint8_t hit[LANES],
+                           const uint8_t active[LANES])
+{
+    // AwfulPlayer ignores the results of its attacks
+    if (s == AWFUL)
+        return;
+
+    for (int lane = 0; lane < LANES; lane++){
+        if (!active[lane] || !hit[lane])
+            continue;
+        // Queue up the untried neighbours of the hit
+        int r = cell[lane] / MAXCOLS, c = cell[lane] % MAXCOLS;
+        const int dr[4] = { -1, 0, 1, 0 };
+        const int dc[4] = { 0, 1, 0, -1 };
+        Bitboard shot(me.shotLo[lane], me.shotHi[lane]);
+        Bitboard queued(me.queuedLo[lane], me.queuedHi[lane]);
+        for (int d = 0; d < 4; d++){
+            Point p(r + dr[d], c + dc[d]);
+            if (!m_game.isValid(p) || shot.test(p.r, p.c) || queued.test(p.r, p.c))
+                continue;
+            queued.set(p.r, p.c);
+            me.queue[lane][me.queueSize[lane]++] = (uint8_t)Bitboard::index(p.r, p.c);
+        }
+        me.queuedLo[lane] = queued.lo();
+        me.queuedHi[lane] = queued.hi();
+    }
+}
+
+bool LockstepEngine::play(Strategy s1, Strategy s2, LockstepResult& result)
+{
+    Strategy strategy[2] = { s1, s2 };
+    for (int side = 0; side < 2; side++){
+        if (!place(strategy[side], m_fleet[side]))
+            return false;
+        Shooter& sh = m_shooter[side];
+        for (int k = 0; k < LANES; k++){
+            sh.shotLo[k] = sh.shotHi[k] = 0;
+            sh.queuedLo[k] = sh.queuedHi[k] = 0;
+            sh.nShots[k] = 0;
+            sh.queueSize[k] = 0;
+        }
+    }
+
+    uint8_t active[LANES];
+    for (int k = 0; k < LANES; k++)
+        active[k] = 1;
+    int nActive = LANES;
+
+    // Same turn order as Game::play: the first strategy shoots on even turns
+    for (int turn = 0; nActive > 0; turn++){
+        int side = turn % 2;
+        int cell[LANES];
+        uint8_t hit[LANES];
+        chooseShots(strategy[side], m_shooter[side], active, cell);
+        fire(cell, active, m_shooter[side], m_fleet[1 - side], hit);
+        learn(strategy[side], m_shooter[side], cell, hit, active);
+
+        // Retire the lanes whose game just ended
+        for (int k = 0; k < LANES; k++){
+            if (active[k] && m_fleet[1 - side].alive[k] == 0){
+                active[k] = 0;
+                result.winner[k] = side;
+                result.shots[k] = m_shooter[side].nShots[k];
+                nActive--;
+            }
+        }
+    }
+    return true;
+}
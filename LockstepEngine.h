@@ -0,0 +1,81 @@
+#ifndef LOCKSTEPENGINE_INCLUDED
+#define LOCKSTEPENGINE_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include <cstdint>
+
+class Game;
+
+// A self-play engine that advances LANES independent computer-vs-computer
+// games in lockstep. Everything the rules need (ship masks, shot masks,
+// cells left per fleet) is stored structure-of-arrays with one slot per
+// game, so applying a turn's shots, detecting hits and detecting wins are
+// straight loops across the lanes that the compiler turns into vector
+// instructions. Only the strategies' choice of cell is scalar, one lane at a
+// time.
+//
+// There is no Board or Player involved; the engine implements its own
+// strategies directly on the masks.
+
+const int LANES = 16;
+
+struct LockstepResult
+{
+    int winner[LANES];    // 0 if the first strategy won that game, 1 if the second did
+    int shots[LANES];     // shots fired by the winner
+};
+
+class LockstepEngine
+{
+  public:
+    enum Strategy {
+        AWFUL,          // same placement and sweep as AwfulPlayer
+        PARITY_HUNT     // random placement; hunt on a checkerboard, then target the neighbours of hits
+    };
+
+    LockstepEngine(const Game& g);
+      // Plays LANES games of s1 (moving first) against s2. Returns false if a
+      // strategy can't place the fleet on this board.
+    bool play(Strategy s1, Strategy s2, LockstepResult& result);
+
+      // We prevent a LockstepEngine object from being copied or assigned
+    LockstepEngine(const LockstepEngine&) = delete;
+    LockstepEngine& operator=(const LockstepEngine&) = delete;
+
+  private:
+      // One side's fleet in every lane
+    struct Fleet
+    {
+        uint64_t shipLo[MAXSHIPS][LANES];
+        uint64_t shipHi[MAXSHIPS][LANES];
+        int alive[LANES];                 // cells of the whole fleet not yet hit
+    };
+      // What one side knows about its shooting in every lane
+    struct Shooter
+    {
+        uint64_t shotLo[LANES];
+        uint64_t shotHi[LANES];
+        int nShots[LANES];
+        uint8_t queue[LANES][MAXROWS * MAXCOLS];   // PARITY_HUNT target stack
+        int queueSize[LANES];
+        uint64_t queuedLo[LANES];
+        uint64_t queuedHi[LANES];
+    };
+
+    bool place(Strategy s, Fleet& f);
+    bool placeRandomly(Fleet& f, int lane);
+    void chooseShots(Strategy s, Shooter& me, const uint8_t active[LANES], int cell[LANES]);
+    void fire(const int cell[LANES], const uint8_t active[LANES], Shooter& me, Fleet& them,
+              uint8_t hit[LANES]);
+    void learn(Strategy s, Shooter& me, const int cell[LANES], const uint8_t hit[LANES],
+               const uint8_t active[LANES]);
+
+    const Game& m_game;
+    Bitboard m_full;      // every cell of the board
+    Bitboard m_even;      // the checkerboard PARITY_HUNT hunts on
+    Fleet m_fleet[2];
+    Shooter m_shooter[2];
+};
+
+#endif // LOCKSTEPENGINE_INCLUDED
@@ -0,0 +1,423 @@
+#include "Mcts.h"
+#include "Game.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const int MAX_CHOICES = 8;          // shots considered at each node
+const double EXPLORATION = 0.05;    // UCT's c; scores are fractions of the board
+const int DETERMINIZE_BUDGET = 4000;   // search steps before giving up on a fleet
+const long long SCALE = 1000000;    // scores are kept in millionths
+const int MAX_NODES = 100000;       // past this the tree stops growing
+
+atomic<int> defaultIterations(1000);
+atomic<int> defaultThreads(1);
+
+// The lowest n-th cell of b
+int nth(Bitboard b, int n)
+{
+    for (; n > 0; n--)
+        b.popFirst();
+    return b.first();
+}
+
+} // namespace
+
+struct MctsPlayer::Node
+{
+    int nShots;
+    short cell[MAX_CHOICES];
+    atomic<int> visits;
+    atomic<int> tries[MAX_CHOICES];
+    atomic<long long> score[MAX_CHOICES];
+    atomic<Node*> next[MAX_CHOICES][3];     // after a miss, a hit, a sink
+
+    void clear()
+    {
+        nShots = 0;
+        visits.store(0, memory_order_relaxed);
+        for (int k = 0; k < MAX_CHOICES; k++){
+            tries[k].store(0, memory_order_relaxed);
+            score[k].store(0, memory_order_relaxed);
+            for (int o = 0; o < 3; o++)
+                next[k][o].store(nullptr, memory_order_relaxed);
+        }
+    }
+};
+
+// A made-up opponent's board, cheap to set up and play out
+struct MctsPlayer::Sim
+{
+    enum { MISS, HIT, SINK };
+    Bitboard tried;
+    Bitboard open;          // hits on ships still afloat
+    Bitboard ship[MAXSHIPS];
+    Bitboard afloat[MAXSHIPS];
+    int nShips;
+    int shipsLeft;
+    int shots;              // fired since the root
+
+    int shoot(int cell)
+    {
+        Bitboard b = Bitboard::bit(cell);
+        tried |= b;
+        shots++;
+        for (int s = 0; s < nShips; s++){
+            if (!afloat[s].intersects(b))
+                continue;
+            afloat[s] = afloat[s].andNot(b);
+            if (afloat[s].any()){
+                open |= b;
+                return HIT;
+            }
+            shipsLeft--;
+            open = open.andNot(ship[s]);
+            return SINK;
+        }
+        return MISS;
+    }
+};
+
+MctsPlayer::MctsPlayer(string nm, const Game& g, Budget budget)
+ : Player(nm, g), m_budget(budget), m_knowledge(g), m_placer(g),
+   m_board(Bitboard::full(g.rows(), g.cols())), m_live(g.nShips()),
+   m_capacity(min(max(budget.iterations, 1), MAX_NODES) + 1), m_used(0), m_left(0), m_done(0),
+   m_lastIterations(0)
+{
+    if (m_budget.threads < 1)
+        m_budget.threads = 1;
+    for (int r = 0; r < g.rows(); r++)
+        for (int c = 0; c < g.cols(); c++)
+            if ((r + c) % 2 == 0)
+                m_parity.set(r, c);
+    m_nodes.reset(new Node[m_capacity]);
+}
+
+MctsPlayer::~MctsPlayer()
+{}
+
+void MctsPlayer::setDefaultBudget(Budget b)
+{
+    defaultIterations.store(b.iterations);
+    defaultThreads.store(b.threads);
+}
+
+MctsPlayer::Budget MctsPlayer::defaultBudget()
+{
+    return Budget(defaultIterations.load(), defaultThreads.load());
+}
+
+bool MctsPlayer::placeShips(Board& b)
+{
+    return m_placer.place(b);
+}
+
+void MctsPlayer::recordAttackResult(Point p, bool validShot, bool shotHit,
+                                    bool shipDestroyed, int shipId)
+{
+    m_pending = Bitboard();
+    if (validShot)
+        m_knowledge.record(p, shotHit, shipDestroyed, shipId);
+}
+
+void MctsPlayer::recordAttackByOpponent(Point /* p */)
+{
+      // Where the opponent shoots says nothing about where its ships are
+}
+
+void MctsPlayer::recordShotPending(Point p)
+{
+    // Searched as if it had been fired already, so the rest of the salvo
+    // goes elsewhere
+    m_pending.set(p.r, p.c);
+}
+
+void MctsPlayer::resetForNewGame()
+{
+    m_knowledge.reset();
+    m_pending = Bitboard();
+}
+
+Bitboard MctsPlayer::around(Bitboard cells) const
+{
+    Bitboard b;
+    while (cells.any()){
+        int i = cells.popFirst();
+        int r = i / MAXCOLS, c = i % MAXCOLS;
+        if (r > 0)
+            b.set(r - 1, c);
+        if (r + 1 < game().rows())
+            b.set(r + 1, c);
+        if (c > 0)
+            b.set(r, c - 1);
+        if (c + 1 < game().cols())
+            b.set(r, c + 1);
+    }
+    return b;
+}
+
+void MctsPlayer::prepare()
+{
+    // What Knowledge allows, copied out so the search threads only ever read it
+    int n = game().nShips();
+    m_order.clear();
+    for (int s = 0; s < n; s++){
+        m_live[s].clear();
+        for (int k = 0; k < m_knowledge.nPlacements(s); k++)
+            if (m_knowledge.possible(s, k))
+                m_live[s].push_back(m_knowledge.placement(s, k));
+        m_order.push_back(s);
+    }
+    // The most hemmed in ships first, so a dead end shows up early
+    sort(m_order.begin(), m_order.end(), [this](int a, int b){ return m_live[a].size() < m_live[b].size(); });
+    m_lengthLeft.assign(n + 1, 0);
+    for (int d = n - 1; d >= 0; d--)
+        m_lengthLeft[d] = m_lengthLeft[d + 1] + game().shipLength(m_order[d]);
+    for (int r = 0; r < game().rows(); r++)
+        for (int c = 0; c < game().cols(); c++){
+            m_density[Bitboard::index(r, c)] = m_knowledge.placements(Point(r, c));
+            m_hitDensity[Bitboard::index(r, c)] = m_knowledge.hitPlacements(Point(r, c));
+        }
+}
+
+bool MctsPlayer::placeFrom(int depth, Bitboard used, Bitboard uncovered, Sim& sim, int& budget) const
+{
+    if (depth == (int)m_order.size())
+        return uncovered.empty();
+    // The ships left can't cover the hits left
+    if (uncovered.count() > m_lengthLeft[depth])
+        return false;
+    int s = m_order[depth];
+    const vector<Bitboard>& live = m_live[s];
+    int n = (int)live.size();
+    if (n == 0)
+        return false;
+    int start = randInt(n);
+    for (int j = 0; j < n; j++){
+        if (--budget < 0)
+            return false;
+        Bitboard cells = live[(start + j) % n];
+        if (cells.intersects(used))
+            continue;
+        sim.ship[s] = cells;
+        if (placeFrom(depth + 1, used | cells, uncovered.andNot(cells), sim, budget))
+            return true;
+    }
+    return false;
+}
+
+bool MctsPlayer::determinize(Sim& sim) const
+{
+    int budget = DETERMINIZE_BUDGET;
+    Bitboard hits = m_knowledge.hits();
+    if (!placeFrom(0, Bitboard(), hits, sim, budget))
+        return false;
+    sim.nShips = game().nShips();
+    // Shots of this salvo still in the air land on this fleet like any other
+    Bitboard fleet;
+    for (int s = 0; s < sim.nShips; s++)
+        fleet |= sim.ship[s];
+    sim.tried = m_knowledge.misses() | hits | m_pending;
+    sim.open = hits | (m_pending & fleet);
+    sim.shipsLeft = 0;
+    sim.shots = 0;
+    for (int s = 0; s < sim.nShips; s++){
+        sim.afloat[s] = sim.ship[s].andNot(sim.tried);
+        if (sim.afloat[s].any())
+            sim.shipsLeft++;
+        else
+            sim.open = sim.open.andNot(sim.ship[s]);
+    }
+    return true;
+}
+
+void MctsPlayer::chooseShots(const Sim& sim, Node& node) const
+{
+    // Next to the hits being chased if there are any, else wherever the most
+    // ships could be; best first
+    Bitboard untried = m_board.andNot(sim.tried);
+    Bitboard choices = around(sim.open) & untried;
+    bool chasing = choices.any();
+    if (!chasing)
+        choices = untried;
+    long long best[MAX_CHOICES];
+    node.nShots = 0;
+    while (choices.any()){
+        int i = choices.popFirst();
+        if (!chasing && m_density[i] == 0)
+            continue;
+        long long key = (long long)m_hitDensity[i] * 65536 + m_density[i];
+        int k = node.nShots < MAX_CHOICES ? node.nShots++ : MAX_CHOICES;
+        for (; k > 0 && best[k - 1] < key; k--)
+            if (k < MAX_CHOICES){
+                best[k] = best[k - 1];
+                node.cell[k] = node.cell[k - 1];
+            }
+        if (k < MAX_CHOICES){
+            best[k] = key;
+            node.cell[k] = (short)i;
+        }
+    }
+    // Only ruled-out cells left; any of them will do
+    if (node.nShots == 0 && untried.any()){
+        node.cell[0] = (short)untried.first();
+        node.nShots = 1;
+    }
+}
+
+MctsPlayer::Node* MctsPlayer::newNode(const Sim& sim)
+{
+    int i = m_used.fetch_add(1, memory_order_relaxed);
+    if (i >= m_capacity)
+        return nullptr;
+    Node* node = &m_nodes[i];
+    node->clear();
+    chooseShots(sim, *node);
+    return node;
+}
+
+void MctsPlayer::rollout(Sim& sim) const
+{
+    // Hunt on the diagonals, then finish off whatever's been hit
+    while (sim.shipsLeft > 0){
+        Bitboard untried = m_board.andNot(sim.tried);
+        if (untried.empty())
+            break;
+        Bitboard choices = around(sim.open) & untried;
+        if (choices.empty()){
+            choices = untried & m_parity;
+            if (choices.empty())
+                choices = untried;
+        }
+        sim.shoot(nth(choices, randInt(choices.count())));
+    }
+}
+
+void MctsPlayer::search(bool reseed, unsigned int seed)
+{
+    if (reseed)
+        seedRandom(seed);
+    Sim sim;
+    Node* path[MAXROWS * MAXCOLS];
+    int taken[MAXROWS * MAXCOLS];
+    long long cells = game().rows() * game().cols();
+    long long done = 0;
+    while (m_left.fetch_sub(1, memory_order_relaxed) > 0){
+        // An iteration takes microseconds, so checking the clock every time is cheap
+        if (pastDeadline())
+            break;
+        done++;
+        if (!determinize(sim))
+            continue;
+
+        // Down the tree by UCT, adding a node where it runs out
+        int depth = 0;
+        Node* node = &m_nodes[0];
+        while (node != nullptr && node->nShots > 0 && sim.shipsLeft > 0){
+            int visits = node->visits.fetch_add(1, memory_order_relaxed) + 1;
+            double logN = log((double)visits);
+            int pick = 0;
+            double bestU = -1;
+            for (int k = 0; k < node->nShots; k++){
+                int n = node->tries[k].load(memory_order_relaxed);
+                if (n == 0){
+                    pick = k;
+                    break;
+                }
+                double u = node->score[k].load(memory_order_relaxed) / double(SCALE * n) +
+                           EXPLORATION * sqrt(logN / n);
+                if (u > bestU){
+                    bestU = u;
+                    pick = k;
+                }
+            }
+            // Counted now, scored when the rollout's back: the virtual loss
+            node->tries[pick].fetch_add(1, memory_order_relaxed);
+            path[depth] = node;
+            taken[depth++] = pick;
+            int outcome = sim.shoot(node->cell[pick]);
+            Node* next = node->next[pick][outcome].load(memory_order_acquire);
+            if (next == nullptr){
+                if (sim.shipsLeft > 0){
+                    Node* fresh = newNode(sim);
+                    Node* expected = nullptr;
+                    if (fresh != nullptr)
+                        node->next[pick][outcome].compare_exchange_strong(expected, fresh, memory_order_acq_rel);
+                }
+                break;
+            }
+            node = next;
+        }
+
+        rollout(sim);
+        long long score = (cells - sim.shots) * SCALE / cells;
+        for (int d = 0; d < depth; d++)
+            path[d]->score[taken[d]].fetch_add(score, memory_order_relaxed);
+    }
+    m_done.fetch_add(done, memory_order_relaxed);
+}
+
+Point MctsPlayer::recommendAttack()
+{
+    prepare();
+    // The root: where things stand now
+    Sim root;
+    root.tried = m_knowledge.misses() | m_knowledge.hits() | m_pending;
+    for (Bitboard b = m_knowledge.hits(); b.any(); ){
+        int i = b.popFirst();
+        if (m_knowledge.openHit(Point(i / MAXCOLS, i % MAXCOLS)))
+            root.open |= Bitboard::bit(i);
+    }
+    m_used.store(0);
+    Node* top = newNode(root);
+    m_lastIterations = 0;
+    if (top->nShots == 0)
+        return Point(0, 0);     // nowhere left to shoot
+    if (top->nShots == 1)
+        return Point(top->cell[0] / MAXCOLS, top->cell[0] % MAXCOLS);
+
+    m_left.store(m_budget.iterations);
+    m_done.store(0);
+    vector<thread> helpers;
+    for (int t = 1; t < m_budget.threads; t++)
+        helpers.push_back(thread(&MctsPlayer::search, this, true, (unsigned int)randomGenerator()()));
+    search(false, 0);
+    for (size_t t = 0; t < helpers.size(); t++)
+        helpers[t].join();
+    m_lastIterations = m_done.load();
+
+    // The most explored shot
+    int best = 0;
+    for (int k = 1; k < top->nShots; k++)
+        if (top->tries[k].load() > top->tries[best].load())
+            best = k;
+    return Point(top->cell[best] / MAXCOLS, top->cell[best] % MAXCOLS);
+}
+
+// Strength against budget: mcts at a few budgets against good
+/*
+#include "Board.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    for (int iterations : { 50, 200, 1000 }){
+        MctsPlayer mcts("mcts", g, MctsPlayer::Budget(iterations, 1));
+        Player* good = createPlayer("good", "good", g);
+        GameResult r;
+        PlayOptions opts;
+        opts.quiet = true;
+        opts.result = &r;
+        int wins = 0;
+        for (int k = 0; k < 200; k++)
+            wins += g.play(k % 2 ? good : (Player*)&mcts, k % 2 ? (Player*)&mcts : good, opts) == &mcts;
+        cout << iterations << " iterations: " << wins / 2.0 << "% wins" << endl;
+        delete good;
+    }
+}
+*/
@@ -0,0 +1,95 @@
+#ifndef MCTS_INCLUDED
+#define MCTS_INCLUDED
+
+#include "Player.h"
+#include "globals.h"
+#include "Bitboard.h"
+#include "Knowledge.h"
+#include "PlacementSampler.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// A player that picks each shot by Monte Carlo tree search. Where the
+// opponent's ships are is hidden, so every iteration of the search first
+// makes up a fleet that fits everything the shots so far have shown (a
+// "determinization", drawn from the placements Knowledge still allows) and
+// plays on that. It walks down the tree choosing shots by UCT, adds one node,
+// and finishes the game with a quick rollout -- the usual hunt-and-target
+// play, on bitboards, on a throwaway copy of the made-up board. The fewer
+// shots it took to sink everything, the better the shots on the way down
+// score. Each node only considers a handful of shots: those next to hits
+// still being chased, else the cells the most placements go through.
+//
+// With more than one thread the threads share the tree. A shot being
+// explored by one thread counts as a visit that scored nothing until its
+// rollout comes back (a "virtual loss"), which steers the other threads to
+// different shots.
+//
+// Strength is bought with compute: a move stops after its budget of
+// iterations or at its deadline (see Player::deadline), whichever comes
+// first. createPlayer's "mcts" uses the default budget; see setDefaultBudget.
+
+class MctsPlayer : public Player
+{
+  public:
+    struct Budget
+    {
+        Budget(int it = 1000, int th = 1) : iterations(it), threads(th) {}
+        int iterations;   // per move
+        int threads;      // searching each move together
+    };
+
+    MctsPlayer(std::string nm, const Game& g, Budget budget);
+    virtual ~MctsPlayer();
+    virtual const char* type() const { return "mcts"; }
+    virtual bool placeShips(Board& b);
+    virtual Point recommendAttack();
+    virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
+                                        bool shipDestroyed, int shipId);
+    virtual void recordAttackByOpponent(Point p);
+    virtual void recordShotPending(Point p);
+    virtual void resetForNewGame();
+      // Iterations actually run for the last move (fewer than the budget if
+      // the deadline came first)
+    long long lastIterations() const { return m_lastIterations; }
+
+      // The budget of every "mcts" player createPlayer makes from now on
+    static void setDefaultBudget(Budget b);
+    static Budget defaultBudget();
+
+  private:
+    struct Node;
+    struct Sim;
+
+    void prepare();
+      // One search thread; helpers get random numbers of their own
+    void search(bool reseed, unsigned int seed);
+    bool determinize(Sim& sim) const;
+    bool placeFrom(int depth, Bitboard used, Bitboard uncovered, Sim& sim, int& budget) const;
+    void rollout(Sim& sim) const;
+    Node* newNode(const Sim& sim);
+    void chooseShots(const Sim& sim, Node& node) const;
+      // The cells next to any of these
+    Bitboard around(Bitboard cells) const;
+
+    Budget m_budget;
+    Knowledge m_knowledge;
+    PlacementSampler m_placer;
+    Bitboard m_board;                            // every cell of the board
+    Bitboard m_parity;                           // every other cell
+    Bitboard m_pending;                          // shots of this salvo not back yet
+    int m_density[MAXROWS * MAXCOLS];            // Knowledge's counts at the root
+    int m_hitDensity[MAXROWS * MAXCOLS];
+    std::vector<std::vector<Bitboard> > m_live;  // by ship, its possible placements
+    std::vector<int> m_order;                    // ships, fewest placements first
+    std::vector<int> m_lengthLeft;               // total length of m_order[d..]
+    std::unique_ptr<Node[]> m_nodes;             // the tree; node 0 is the root
+    int m_capacity;
+    std::atomic<int> m_used;
+    std::atomic<int> m_left;                     // iterations still to run
+    std::atomic<long long> m_done;
+    long long m_lastIterations;
+};
+
+#endif // MCTS_INCLUDED
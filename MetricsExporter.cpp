@@ -0,0 +1,203 @@
+#include "MetricsExporter.h"
+#include "Tournament.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+MetricsExporter::MetricsExporter(const Tournament& t, const string& path, Format format,
+                                 double intervalSeconds)
+ : m_tournament(t), m_path(path), m_format(format), m_interval(intervalSeconds),
+   m_stopping(false), m_lastGames(0), m_lastTime(chrono::steady_clock::now())
+{}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+void MetricsExporter::start()
+{
+    if (m_thread.joinable())
+        return;
+    m_stopping = false;
+    m_thread = thread(&MetricsExporter::loop, this);
+}
+
+void MetricsExporter::stop()
+{
+    if (!m_thread.joinable())
+        return;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+    // The final numbers
+    writeNow();
+}
+
+void MetricsExporter::loop()
+{
+    unique_lock<mutex> lock(m_mutex);
+    while (!m_stopping){
+        if (m_wake.wait_for(lock, m_interval, [this]{ return m_stopping; }))
+            break;
+        lock.unlock();
+        writeNow();
+        lock.lock();
+    }
+}
+
+namespace {
+
+struct Snapshot
+{
+    struct Pairing
+    {
+        string type[2];
+        long long games, wins[2];
+        double p50, p90, p99;
+    };
+    long long games;
+    double gamesPerSecond;
+    vector<Pairing> pairings;
+    map<string, pair<long long, long long> > strategies;   // type -> (wins, decided games played)
+};
+
+string escaped(const string& s)
+{
+    string out;
+    for (size_t k = 0; k < s.size(); k++){
+        if (s[k] == '"' || s[k] == '\\')
+            out += '\\';
+        out += s[k];
+    }
+    return out;
+}
+
+void writePrometheus(ostream& out, const Snapshot& s)
+{
+    out << "# HELP battleship_games_completed_total Games finished so far\n"
+        << "# TYPE battleship_games_completed_total counter\n"
+        << "battleship_games_completed_total " << s.games << "\n"
+        << "# HELP battleship_games_per_second Games finished per second since the last snapshot\n"
+        << "# TYPE battleship_games_per_second gauge\n"
+        << "battleship_games_per_second " << s.gamesPerSecond << "\n"
+        << "# HELP battleship_strategy_win_rate Fraction of decided games won, over every matchup\n"
+        << "# TYPE battleship_strategy_win_rate gauge\n";
+    for (map<string, pair<long long, long long> >::const_iterator p = s.strategies.begin(); p != s.strategies.end(); p++)
+        if (p->second.second > 0)
+            out << "battleship_strategy_win_rate{strategy=\"" << escaped(p->first) << "\"} "
+                << double(p->second.first) / p->second.second << "\n";
+
+    out << "# HELP battleship_matchup_games_total Games finished per matchup\n"
+        << "# TYPE battleship_matchup_games_total counter\n";
+    for (size_t k = 0; k < s.pairings.size(); k++){
+        const Snapshot::Pairing& p = s.pairings[k];
+        out << "battleship_matchup_games_total{first=\"" << escaped(p.type[0]) << "\",second=\""
+            << escaped(p.type[1]) << "\"} " << p.games << "\n";
+    }
+    out << "# HELP battleship_matchup_wins_total Games won by each side of a matchup\n"
+        << "# TYPE battleship_matchup_wins_total counter\n";
+    for (size_t k = 0; k < s.pairings.size(); k++){
+        const Snapshot::Pairing& p = s.pairings[k];
+        for (int side = 0; side < 2; side++)
+            out << "battleship_matchup_wins_total{first=\"" << escaped(p.type[0]) << "\",second=\""
+                << escaped(p.type[1]) << "\",side=\"" << side << "\"} " << p.wins[side] << "\n";
+    }
+    out << "# HELP battleship_move_latency_ns Time per recommendAttack in nanoseconds\n"
+        << "# TYPE battleship_move_latency_ns summary\n";
+    for (size_t k = 0; k < s.pairings.size(); k++){
+        const Snapshot::Pairing& p = s.pairings[k];
+        const char* q[3] = { "0.5", "0.9", "0.99" };
+        const double v[3] = { p.p50, p.p90, p.p99 };
+        for (int i = 0; i < 3; i++)
+            out << "battleship_move_latency_ns{first=\"" << escaped(p.type[0]) << "\",second=\""
+                << escaped(p.type[1]) << "\",quantile=\"" << q[i] << "\"} " << v[i] << "\n";
+    }
+}
+
+void writeJson(ostream& out, const Snapshot& s)
+{
+    out << "{\n  \"games_completed\": " << s.games << ",\n"
+        << "  \"games_per_second\": " << s.gamesPerSecond << ",\n"
+        << "  \"strategies\": {";
+    bool first = true;
+    for (map<string, pair<long long, long long> >::const_iterator p = s.strategies.begin(); p != s.strategies.end(); p++){
+        out << (first ? "\n" : ",\n") << "    \"" << escaped(p->first) << "\": {\"wins\": " << p->second.first
+            << ", \"decided\": " << p->second.second << ", \"win_rate\": "
+            << (p->second.second > 0 ? double(p->second.first) / p->second.second : 0.0) << "}";
+        first = false;
+    }
+    out << "\n  },\n  \"matchups\": [";
+    for (size_t k = 0; k < s.pairings.size(); k++){
+        const Snapshot::Pairing& p = s.pairings[k];
+        out << (k == 0 ? "\n" : ",\n") << "    {\"first\": \"" << escaped(p.type[0]) << "\", \"second\": \""
+            << escaped(p.type[1]) << "\", \"games\": " << p.games << ", \"wins\": [" << p.wins[0] << ", "
+            << p.wins[1] << "], \"move_latency_ns\": {\"p50\": " << p.p50 << ", \"p90\": " << p.p90
+            << ", \"p99\": " << p.p99 << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+bool MetricsExporter::writeNow()
+{
+    // The background thread and a caller can both get here; they share the
+    // temporary file and the games-per-second counters
+    lock_guard<mutex> lock(m_writeMutex);
+
+    // Gather the numbers first; merged() only reads the workers' totals
+    Snapshot s;
+    s.games = 0;
+    for (int m = 0; m < m_tournament.nMatchups(); m++){
+        MatchupStats total;
+        m_tournament.merged(m, total);
+        Snapshot::Pairing p;
+        for (int side = 0; side < 2; side++){
+            p.type[side] = m_tournament.matchupType(m, side);
+            p.wins[side] = total.wins[side];
+        }
+        p.games = total.games;
+        p.p50 = total.moveLatency.percentile(0.5);
+        p.p90 = total.moveLatency.percentile(0.9);
+        p.p99 = total.moveLatency.percentile(0.99);
+        s.games += p.games;
+        long long decided = p.wins[0] + p.wins[1];
+        for (int side = 0; side < 2; side++){
+            pair<long long, long long>& st = s.strategies[p.type[side]];
+            st.first += p.wins[side];
+            st.second += decided;
+        }
+        s.pairings.push_back(p);
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - m_lastTime).count();
+    s.gamesPerSecond = seconds > 0 ? (s.games - m_lastGames) / seconds : 0;
+    m_lastGames = s.games;
+    m_lastTime = now;
+
+    // Write next to the real file, then rename over it in one step
+    string tmp = m_path + ".tmp";
+    {
+        ofstream out(tmp.c_str());
+        if (!out)
+            return false;
+        out << fixed << setprecision(4);
+        if (m_format == PROMETHEUS)
+            writePrometheus(out, s);
+        else
+            writeJson(out, s);
+        out.close();
+        if (!out)
+            return false;
+    }
+    return rename(tmp.c_str(), m_path.c_str()) == 0;
+}
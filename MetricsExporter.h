@@ -0,0 +1,54 @@
+#ifndef METRICSEXPORTER_INCLUDED
+#define METRICSEXPORTER_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class Tournament;
+
+// Periodically writes a snapshot of a running Tournament to a local file, in
+// Prometheus text exposition format or JSON: games completed, games per
+// second since the last snapshot, win rates per strategy and per matchup,
+// and move latency percentiles. Each snapshot is written to a temporary file
+// and renamed over the old one, so a reader never sees a half-written file.
+// Taking a snapshot only reads the workers' totals; it never stalls them.
+class MetricsExporter
+{
+  public:
+    enum Format { PROMETHEUS, JSON };
+
+    MetricsExporter(const Tournament& t, const std::string& path, Format format,
+                    double intervalSeconds);
+      // Stops the background thread, if it's running, after one last snapshot
+    ~MetricsExporter();
+    void start();
+    void stop();
+      // Takes a snapshot right away; returns false if the file couldn't be
+      // written. Safe to call while the background thread is running.
+    bool writeNow();
+      // We prevent a MetricsExporter object from being copied or assigned
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  private:
+    void loop();
+
+    const Tournament& m_tournament;
+    std::string m_path;
+    Format m_format;
+    std::chrono::duration<double> m_interval;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+    // Held while a snapshot is taken and written, by whichever thread
+    std::mutex m_writeMutex;
+    // For games per second
+    long long m_lastGames;
+    std::chrono::steady_clock::time_point m_lastTime;
+};
+
+#endif // METRICSEXPORTER_INCLUDED
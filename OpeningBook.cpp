@@ -0,0 +1,266 @@
+#include "OpeningBook.h"
+#include "Game.h"
+#include "Endian.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[4] = { 'B', 'S', 'O', 'B' };
+const uint32_t VERSION = 1;
+const int SLOT_SIZE = 16;          // hash, row, column, padding
+const double HIT_WEIGHT = 50;      // how much more a placement through a hit counts
+
+atomic<const OpeningBook*> sharedBook(nullptr);
+
+uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+struct Position
+{
+    Bitboard misses;
+    Bitboard hits;
+    uint64_t hash;
+    int depth;
+};
+
+// The untried cell the most weighted ship placements go through, or -1 if
+// there's no untried cell left
+int bestCell(const Game& g, const vector<vector<Bitboard> >& placements, Bitboard misses, Bitboard hits)
+{
+    double score[MAXROWS * MAXCOLS] = { 0 };
+    Bitboard tried = misses | hits;
+    for (size_t s = 0; s < placements.size(); s++)
+        for (size_t k = 0; k < placements[s].size(); k++){
+            Bitboard cells = placements[s][k];
+            if (cells.intersects(misses))
+                continue;
+            double w = pow(HIT_WEIGHT, (cells & hits).count());
+            for (Bitboard open = cells.andNot(tried); open.any(); )
+                score[open.popFirst()] += w;
+        }
+    int best = -1;
+    Bitboard untried = Bitboard::full(g.rows(), g.cols()).andNot(tried);
+    for (Bitboard b = untried; b.any(); ){
+        int i = b.popFirst();
+        if (best < 0 || score[i] > score[best])
+            best = i;
+    }
+    return best;
+}
+
+} // namespace
+
+uint64_t OpeningBook::zobrist(int cell, bool hit)
+{
+    return mix(0x5eed0000ULL + 2 * cell + (hit ? 1 : 0));
+}
+
+bool OpeningBook::build(const Game& g, int depth, const string& path)
+{
+    // Every way each ship can lie on the board
+    vector<vector<Bitboard> > placements(g.nShips());
+    for (int s = 0; s < g.nShips(); s++)
+        for (int r = 0; r < g.rows(); r++)
+            for (int c = 0; c < g.cols(); c++){
+                int len = g.shipLength(s);
+                if (c + len <= g.cols())
+                    placements[s].push_back(shipCells(Point(r, c), len, HORIZONTAL));
+                if (len > 1 && r + len <= g.rows())
+                    placements[s].push_back(shipCells(Point(r, c), len, VERTICAL));
+            }
+
+    // Walk the tree of positions the book's moves lead to
+    vector<pair<uint64_t, int> > entries;
+    unordered_set<uint64_t> seen;
+    vector<Position> todo;
+    Position start;
+    start.hash = START;
+    start.depth = 0;
+    todo.push_back(start);
+    while (!todo.empty()){
+        Position pos = todo.back();
+        todo.pop_back();
+        if (pos.depth >= depth || !seen.insert(pos.hash).second)
+            continue;
+        int cell = bestCell(g, placements, pos.misses, pos.hits);
+        if (cell < 0)
+            continue;
+        entries.push_back(make_pair(pos.hash, cell));
+        for (int hit = 0; hit < 2; hit++){
+            Position next = pos;
+            (hit ? next.hits : next.misses) |= Bitboard::bit(cell);
+            next.hash ^= zobrist(cell, hit != 0);
+            next.depth++;
+            todo.push_back(next);
+        }
+    }
+
+    // At most half full, so probes stay short
+    uint64_t capacity = 16;
+    while (capacity < 2 * entries.size())
+        capacity *= 2;
+    vector<uint8_t> slots(capacity * SLOT_SIZE, 0);
+    for (size_t k = 0; k < entries.size(); k++){
+        uint64_t hash = entries[k].first;
+        if (hash == 0)      // 0 marks an empty slot; this position just won't be in the book
+            continue;
+        uint64_t i = hash & (capacity - 1);
+        while (loadLE(&slots[i * SLOT_SIZE], 8) != 0)
+            i = (i + 1) & (capacity - 1);
+        uint8_t* slot = &slots[i * SLOT_SIZE];
+        storeLE(slot, hash, 8);
+        slot[8] = (uint8_t)(entries[k].second / MAXCOLS);
+        slot[9] = (uint8_t)(entries[k].second % MAXCOLS);
+    }
+
+    vector<uint8_t> out(MAGIC, MAGIC + 4);
+    appendLE(out, VERSION, 4);
+    appendLE(out, g.rows(), 4);
+    appendLE(out, g.cols(), 4);
+    appendLE(out, g.nShips(), 4);
+    for (int s = 0; s < g.nShips(); s++)
+        appendLE(out, g.shipLength(s), 4);
+    appendLE(out, depth, 4);
+    appendLE(out, entries.size(), 8);
+    appendLE(out, capacity, 8);
+    // The table starts on a slot boundary
+    while (out.size() % SLOT_SIZE != 0)
+        out.push_back(0);
+    out.insert(out.end(), slots.begin(), slots.end());
+
+    ofstream f(path.c_str(), ios::binary);
+    f.write((const char*)&out[0], out.size());
+    f.close();
+    return bool(f);
+}
+
+OpeningBook::OpeningBook(const string& path)
+ : m_data(nullptr), m_size(0), m_rows(0), m_cols(0), m_nShips(0), m_depth(0), m_positions(0),
+   m_slots(nullptr), m_mask(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= 24)
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return;
+    const uint8_t* data = (const uint8_t*)p;
+    size_t size = st.st_size;
+
+    size_t nShips = loadLE(data + 16, 4);
+    size_t header = 20 + 4 * nShips + 4 + 16;
+    header = (header + SLOT_SIZE - 1) / SLOT_SIZE * SLOT_SIZE;
+    if (memcmp(data, MAGIC, 4) != 0 || loadLE(data + 4, 4) != VERSION || nShips > MAXSHIPS ||
+            header > size){
+        munmap(p, size);
+        return;
+    }
+    m_nShips = (int)nShips;
+    for (int s = 0; s < m_nShips; s++)
+        m_lengths[s] = (int)loadLE(data + 20 + 4 * s, 4);
+    const uint8_t* rest = data + 20 + 4 * nShips;
+    uint64_t capacity = loadLE(rest + 12, 8);
+    // The table has to be a power of two in size and all there (checked
+    // without multiplying, which a bad capacity could overflow)
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > (size - header) / SLOT_SIZE){
+        munmap(p, size);
+        return;
+    }
+    m_data = data;
+    m_size = size;
+    m_rows = (int)loadLE(data + 8, 4);
+    m_cols = (int)loadLE(data + 12, 4);
+    m_depth = (int)loadLE(rest, 4);
+    m_positions = (long long)loadLE(rest + 4, 8);
+    m_slots = data + header;
+    m_mask = capacity - 1;
+}
+
+OpeningBook::~OpeningBook()
+{
+    if (m_data != nullptr)
+        munmap((void*)m_data, m_size);
+}
+
+bool OpeningBook::matches(const Game& g) const
+{
+    if (m_data == nullptr || g.rows() != m_rows || g.cols() != m_cols || g.nShips() != m_nShips)
+        return false;
+    for (int s = 0; s < m_nShips; s++)
+        if (g.shipLength(s) != m_lengths[s])
+            return false;
+    return true;
+}
+
+bool OpeningBook::probe(uint64_t hash, Point& p) const
+{
+    if (m_slots == nullptr || hash == 0)
+        return false;
+    // A book we wrote is never full, but a damaged one could be: stop after
+    // one lap of the table
+    uint64_t i = hash & m_mask;
+    for (uint64_t step = 0; step <= m_mask; step++, i = (i + 1) & m_mask){
+        const uint8_t* slot = m_slots + i * SLOT_SIZE;
+        uint64_t key = loadLE(slot, 8);
+        if (key == 0)
+            return false;
+        if (key == hash){
+            // A damaged slot's move could be off the board
+            if (slot[8] >= m_rows || slot[9] >= m_cols)
+                return false;
+            p = Point(slot[8], slot[9]);
+            return true;
+        }
+    }
+    return false;
+}
+
+void OpeningBook::setShared(const OpeningBook* book)
+{
+    sharedBook.store(book, memory_order_release);
+}
+
+const OpeningBook* OpeningBook::shared()
+{
+    return sharedBook.load(memory_order_acquire);
+}
+
+// Build a book for the usual fleet and show its first moves
+/*
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    OpeningBook::build(g, 12, "opening.book");
+    OpeningBook book("opening.book");
+    cout << book.positions() << " positions" << endl;
+    uint64_t hash = OpeningBook::START;
+    Point p;
+    while (book.probe(hash, p)){
+        cout << "(" << p.r << "," << p.c << ") ";
+        hash ^= OpeningBook::zobrist(Bitboard::index(p.r, p.c), false);   // suppose it missed
+    }
+    cout << endl;
+}
+*/
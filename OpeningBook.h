@@ -0,0 +1,72 @@
+#ifndef OPENINGBOOK_INCLUDED
+#define OPENINGBOOK_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include <cstdint>
+#include <string>
+
+class Game;
+
+// Precomputed first shots. Early in a game all a player knows is which of
+// its few shots missed and which hit, so the best next shot can be worked out
+// ahead of time for every position the book's own moves can lead to. build
+// walks that tree (each book move either misses or hits) to a given depth
+// and picks each move by counting, for every untried cell, the placements of
+// every ship that cover it without covering a miss -- with placements
+// through hits weighted heavily, so a hit gets followed up.
+//
+// Positions are keyed by a Zobrist hash of the misses and hits, which a
+// player can keep up to date with one XOR per shot. The file is an
+// open-addressing hash table that's mapped into memory, so a probe is a
+// hash and a load or two.
+//
+// GoodPlayer uses the shared book (see setShared) while it's in the book and
+// nothing has been sunk, provided the book was built for its game's board
+// and fleet.
+
+class OpeningBook
+{
+  public:
+      // The hash of a position with no shots fired
+    static const uint64_t START = 0x6a09e667f3bcc908ULL;
+      // What a shot at the cell with the given Bitboard index adds to the hash
+    static uint64_t zobrist(int cell, bool hit);
+
+      // Works out the book for g down to depth shots and writes it to path
+    static bool build(const Game& g, int depth, const std::string& path);
+
+    OpeningBook(const std::string& path);
+    ~OpeningBook();
+    bool ok() const { return m_data != nullptr; }
+      // Whether the book was built for this board size and fleet
+    bool matches(const Game& g) const;
+    int depth() const { return m_depth; }
+    long long positions() const { return m_positions; }
+      // The book move for the position with this hash, if there is one and
+      // it's on the board
+    bool probe(uint64_t hash, Point& p) const;
+
+      // The book every GoodPlayer consults from its next game on (nullptr for
+      // none). It has to outlive the games that use it.
+    static void setShared(const OpeningBook* book);
+    static const OpeningBook* shared();
+
+      // We prevent an OpeningBook object from being copied or assigned
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+  private:
+    const uint8_t* m_data;
+    size_t m_size;
+    int m_rows;
+    int m_cols;
+    int m_nShips;
+    int m_lengths[MAXSHIPS];
+    int m_depth;
+    long long m_positions;
+    const uint8_t* m_slots;
+    uint64_t m_mask;
+};
+
+#endif // OPENINGBOOK_INCLUDED
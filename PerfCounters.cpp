@@ -0,0 +1,220 @@
+#include "PerfCounters.h"
+#include <iostream>
+
+#ifdef BATTLESHIP_PERF
+
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const int NCOUNTERS = 4;
+const int MAXSLOTS = 64;
+
+// PerfCounts as the table keeps them: perfReport reads them while their
+// thread may still be counting, so they're atomics -- but relaxed, and with
+// only one writer, a load and a store rather than a locked add
+struct SlotCounts
+{
+    atomic<uint64_t> calls;
+    atomic<uint64_t> cycles;
+    atomic<uint64_t> instructions;
+    atomic<uint64_t> branchMisses;
+    atomic<uint64_t> cacheMisses;
+};
+
+struct PerfSlot
+{
+    const char* operation;
+    const char* strategy;
+    SlotCounts counts;
+};
+
+// Each thread owns its counter group and its table of totals. The table is
+// only written by its thread; perfReport takes the mutex just to walk the
+// list of tables, never while a thread is counting.
+struct PerfThread
+{
+    int fds[NCOUNTERS];
+    bool ok;
+    PerfSlot slots[MAXSLOTS];
+    atomic<int> nSlots;
+    PerfThread* next;
+};
+
+mutex g_threadsMutex;
+PerfThread* g_threads = nullptr;
+
+int openCounter(uint32_t type, uint64_t config, int groupFd)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+PerfThread* threadCounters()
+{
+    static thread_local PerfThread* t_counters = nullptr;
+    if (t_counters != nullptr)
+        return t_counters;
+
+    PerfThread* t = new PerfThread;
+    t->nSlots.store(0, memory_order_relaxed);
+    const uint64_t configs[NCOUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    // The cycles counter leads the group so all four are scheduled together
+    t->ok = true;
+    for (int k = 0; k < NCOUNTERS; k++){
+        t->fds[k] = openCounter(PERF_TYPE_HARDWARE, configs[k], k == 0 ? -1 : t->fds[0]);
+        if (t->fds[k] == -1)
+            t->ok = false;
+    }
+    if (t->ok){
+        ioctl(t->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(t->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    else{
+        for (int k = 0; k < NCOUNTERS; k++)
+            if (t->fds[k] != -1)
+                close(t->fds[k]);
+    }
+
+    lock_guard<mutex> lock(g_threadsMutex);
+    t->next = g_threads;
+    g_threads = t;
+    t_counters = t;
+    return t;
+}
+
+inline void bump(atomic<uint64_t>& a, uint64_t by)
+{
+    a.store(a.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+} // namespace
+
+bool perfRead(PerfCounts& now)
+{
+    PerfThread* t = threadCounters();
+    if (!t->ok)
+        return false;
+    uint64_t buf[1 + NCOUNTERS];
+    if (read(t->fds[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+        return false;
+    now.calls = 0;
+    now.cycles = buf[1];
+    now.instructions = buf[2];
+    now.branchMisses = buf[3];
+    now.cacheMisses = buf[4];
+    return true;
+}
+
+void perfAccumulate(const char* operation, const char* strategy,
+                    const PerfCounts& start, const PerfCounts& end)
+{
+    PerfThread* t = threadCounters();
+    int n = t->nSlots.load(memory_order_relaxed);
+    int k = 0;
+    while (k < n && (t->slots[k].operation != operation || t->slots[k].strategy != strategy))
+        k++;
+    if (k == n){
+        // A new (operation, strategy) pair; if the table is full we stop counting new pairs
+        if (n == MAXSLOTS)
+            return;
+        t->slots[k].operation = operation;
+        t->slots[k].strategy = strategy;
+        SlotCounts& fresh = t->slots[k].counts;
+        fresh.calls.store(0, memory_order_relaxed);
+        fresh.cycles.store(0, memory_order_relaxed);
+        fresh.instructions.store(0, memory_order_relaxed);
+        fresh.branchMisses.store(0, memory_order_relaxed);
+        fresh.cacheMisses.store(0, memory_order_relaxed);
+        t->nSlots.store(n + 1, memory_order_release);
+    }
+    SlotCounts& c = t->slots[k].counts;
+    bump(c.calls, 1);
+    bump(c.cycles, end.cycles - start.cycles);
+    bump(c.instructions, end.instructions - start.instructions);
+    bump(c.branchMisses, end.branchMisses - start.branchMisses);
+    bump(c.cacheMisses, end.cacheMisses - start.cacheMisses);
+}
+
+bool perfAvailable()
+{
+    return threadCounters()->ok;
+}
+
+void perfReport(ostream& out)
+{
+    // Merge the per-thread tables; the same literal may live at different addresses, so key by contents
+    map<pair<string, string>, PerfCounts> totals;
+    {
+        lock_guard<mutex> lock(g_threadsMutex);
+        for (PerfThread* t = g_threads; t != nullptr; t = t->next){
+            int n = t->nSlots.load(memory_order_acquire);
+            for (int k = 0; k < n; k++){
+                PerfCounts& c = totals[make_pair(string(t->slots[k].strategy), string(t->slots[k].operation))];
+                const SlotCounts& s = t->slots[k].counts;
+                c.calls += s.calls.load(memory_order_relaxed);
+                c.cycles += s.cycles.load(memory_order_relaxed);
+                c.instructions += s.instructions.load(memory_order_relaxed);
+                c.branchMisses += s.branchMisses.load(memory_order_relaxed);
+                c.cacheMisses += s.cacheMisses.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    if (totals.empty()){
+        out << "No performance counter data" << (perfAvailable() ? "" : " (counters unavailable)") << endl;
+        return;
+    }
+    out << left << setw(10) << "strategy" << setw(20) << "operation" << right
+        << setw(10) << "calls" << setw(14) << "cycles/call" << setw(12) << "instr/call"
+        << setw(8) << "IPC" << setw(12) << "br-miss/ki" << setw(14) << "cache-miss/ki" << endl;
+    out << fixed << setprecision(2);
+    for (map<pair<string, string>, PerfCounts>::const_iterator p = totals.begin(); p != totals.end(); p++){
+        const PerfCounts& c = p->second;
+        double calls = c.calls > 0 ? c.calls : 1;
+        double ki = c.instructions > 0 ? c.instructions / 1000.0 : 1;
+        out << left << setw(10) << p->first.first << setw(20) << p->first.second << right
+            << setw(10) << c.calls
+            << setw(14) << c.cycles / calls
+            << setw(12) << c.instructions / calls
+            << setw(8) << (c.cycles > 0 ? double(c.instructions) / c.cycles : 0.0)
+            << setw(12) << c.branchMisses / ki
+            << setw(14) << c.cacheMisses / ki << endl;
+    }
+}
+
+#else
+
+bool perfAvailable()
+{
+    return false;
+}
+
+void perfReport(std::ostream& out)
+{
+    out << "Performance counters not compiled in (build with BATTLESHIP_PERF)" << std::endl;
+}
+
+#endif // BATTLESHIP_PERF
@@ -0,0 +1,75 @@
+#ifndef PERFCOUNTERS_INCLUDED
+#define PERFCOUNTERS_INCLUDED
+
+#include <cstdint>
+#include <iosfwd>
+
+// Optional hardware performance counters (Linux perf_event_open). Build with
+// BATTLESHIP_PERF defined and every PERF_SCOPE adds the cycles, instructions,
+// branch misses and cache misses its block took on the calling thread to a
+// per-thread table keyed by (operation, strategy). perfReport merges the
+// tables. Counts are inclusive: a Board::placeShip inside some placeShips is
+// counted under both. Without BATTLESHIP_PERF the macro expands to nothing.
+//
+// If the kernel refuses to open the counters (no PMU, or
+// /proc/sys/kernel/perf_event_paranoid too strict) the scopes quietly record
+// nothing and perfAvailable() says so.
+
+struct PerfCounts
+{
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t branchMisses;
+    uint64_t cacheMisses;
+};
+
+#ifdef BATTLESHIP_PERF
+
+bool perfRead(PerfCounts& now);
+void perfAccumulate(const char* operation, const char* strategy,
+                    const PerfCounts& start, const PerfCounts& end);
+
+class PerfScope
+{
+  public:
+    PerfScope(const char* operation, const char* strategy)
+     : m_operation(operation), m_strategy(strategy)
+    {
+        m_ok = perfRead(m_start);
+    }
+    ~PerfScope()
+    {
+        PerfCounts end;
+        if (m_ok && perfRead(end))
+            perfAccumulate(m_operation, m_strategy, m_start, end);
+    }
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+  private:
+    const char* m_operation;
+    const char* m_strategy;
+    PerfCounts m_start;
+    bool m_ok;
+};
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+#define PERF_SCOPE(operation, strategy) \
+    PerfScope PERF_CONCAT(perfScope_, __LINE__)(operation, strategy)
+
+#else
+
+#define PERF_SCOPE(operation, strategy) ((void)0)
+
+#endif // BATTLESHIP_PERF
+
+  // True if counters are compiled in and the kernel let the calling thread open them
+bool perfAvailable();
+
+  // Writes one line per (strategy, operation) with totals, per-call averages,
+  // IPC, and branch/cache misses per thousand instructions
+void perfReport(std::ostream& out);
+
+#endif // PERFCOUNTERS_INCLUDED
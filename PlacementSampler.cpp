@@ -0,0 +1,165 @@
+#include "PlacementSampler.h"
+#include "Game.h"
+#include "Board.h"
+#include <algorithm>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+const int DRAWS = 300;               // rejection draws before searching instead
+const long long SEARCH_BUDGET = 1000000;
+
+} // namespace
+
+PlacementSampler::PlacementSampler(const Game& g)
+ : m_game(g), m_options(g.nShips()), m_cumulative(g.nShips()), m_impossible(false)
+{
+    for (int s = 0; s < g.nShips(); s++){
+        int len = g.shipLength(s);
+        for (int r = 0; r < g.rows(); r++)
+            for (int c = 0; c < g.cols(); c++){
+                Option o;
+                o.where.topOrLeft = Point(r, c);
+                if (c + len <= g.cols()){
+                    o.cells = shipCells(Point(r, c), len, HORIZONTAL);
+                    o.where.dir = HORIZONTAL;
+                    m_options[s].push_back(o);
+                }
+                // A one-cell ship lies the same either way; count it once
+                if (len > 1 && r + len <= g.rows()){
+                    o.cells = shipCells(Point(r, c), len, VERTICAL);
+                    o.where.dir = VERTICAL;
+                    m_options[s].push_back(o);
+                }
+            }
+    }
+}
+
+void PlacementSampler::setCellWeights(const vector<double>& weights)
+{
+    for (int s = 0; s < m_game.nShips(); s++){
+        vector<double>& cum = m_cumulative[s];
+        cum.clear();
+        double total = 0;
+        for (size_t k = 0; k < m_options[s].size(); k++){
+            double w = 1;
+            for (Bitboard b = m_options[s][k].cells; b.any(); ){
+                int i = b.popFirst();
+                w *= weights[(i / MAXCOLS) * m_game.cols() + i % MAXCOLS];
+            }
+            total += w;
+            cum.push_back(total);
+        }
+    }
+}
+
+int PlacementSampler::draw(int ship) const
+{
+    const vector<double>& cum = m_cumulative[ship];
+    if (cum.empty())
+        return randInt((int)m_options[ship].size());
+    uniform_real_distribution<double> u(0, cum.back());
+    int k = (int)(upper_bound(cum.begin(), cum.end(), u(randomGenerator())) - cum.begin());
+    return min(k, (int)cum.size() - 1);
+}
+
+bool PlacementSampler::search(int ship, Bitboard used, Placement* fleet, long long& budget)
+{
+    if (ship == m_game.nShips())
+        return true;
+    const vector<Option>& options = m_options[ship];
+    int n = (int)options.size();
+    // Visit this ship's placements starting from a random one
+    int start = randInt(n);
+    for (int k = 0; k < n; k++){
+        if (--budget < 0)
+            return false;
+        const Option& o = options[(start + k) % n];
+        if (o.cells.intersects(used))
+            continue;
+        fleet[ship] = o.where;
+        if (search(ship + 1, used | o.cells, fleet, budget))
+            return true;
+    }
+    return false;
+}
+
+bool PlacementSampler::sample(Placement* fleet)
+{
+    if (m_impossible)
+        return false;
+    for (int s = 0; s < m_game.nShips(); s++)
+        if (m_options[s].empty())
+            return false;
+
+    for (int attempt = 0; attempt < DRAWS; attempt++){
+        Bitboard used;
+        int s = 0;
+        for (; s < m_game.nShips(); s++){
+            const Option& o = m_options[s][draw(s)];
+            if (o.cells.intersects(used))
+                break;
+            used |= o.cells;
+            fleet[s] = o.where;
+        }
+        if (s == m_game.nShips())
+            return true;
+    }
+
+    // Too cramped to hit on a fleet by chance
+    long long budget = SEARCH_BUDGET;
+    if (search(0, Bitboard(), fleet, budget))
+        return true;
+    // Having run through every option without running out of budget settles it
+    if (budget >= 0)
+        m_impossible = true;
+    return false;
+}
+
+bool PlacementSampler::place(Board& b)
+{
+    Placement fleet[MAXSHIPS];
+    if (!sample(fleet))
+        return false;
+    for (int s = 0; s < m_game.nShips(); s++)
+        if (!b.placeShip(fleet[s].topOrLeft, s, fleet[s].dir)){
+            // Something was already on the board; leave it as we found it
+            for (int k = 0; k < s; k++)
+                b.unplaceShip(fleet[k].topOrLeft, k, fleet[k].dir);
+            return false;
+        }
+    return true;
+}
+
+// How often each cell gets a ship, over many fleets
+/*
+#include <iostream>
+#include <iomanip>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    PlacementSampler sampler(g);
+    PlacementSampler::Placement fleet[MAXSHIPS];
+    int count[MAXROWS][MAXCOLS] = {};
+    const int n = 100000;
+    for (int k = 0; k < n; k++){
+        sampler.sample(fleet);
+        for (int s = 0; s < g.nShips(); s++)
+            for (int i = 0; i < g.shipLength(s); i++){
+                Point p = fleet[s].topOrLeft;
+                if (fleet[s].dir == HORIZONTAL)
+                    count[p.r][p.c + i]++;
+                else
+                    count[p.r + i][p.c]++;
+            }
+    }
+    for (int r = 0; r < g.rows(); r++){
+        for (int c = 0; c < g.cols(); c++)
+            cout << setw(5) << count[r][c] * 1000 / n;
+        cout << endl;
+    }
+}
+*/
@@ -0,0 +1,60 @@
+#ifndef PLACEMENTSAMPLER_INCLUDED
+#define PLACEMENTSAMPLER_INCLUDED
+
+#include "globals.h"
+#include "Bitboard.h"
+#include <vector>
+
+class Game;
+class Board;
+
+// Random fleet placement. Every way each ship can lie on the board is worked
+// out once, as cell masks. sample draws a placement for each ship on its own
+// and starts the fleet over if two overlap, which makes every legal fleet
+// exactly equally likely. On a board too cramped for that to succeed within
+// a few hundred draws it switches to a depth-first search over the same masks
+// in random order, which either finds a fleet or proves there's none within
+// a fixed budget of steps -- it never loops forever. The search's fleets are
+// random but not equally likely: it takes the first fleet it comes to from a
+// random starting point for each ship, so a placement just past a run of
+// dead ends comes up more often than its share.
+//
+// setCellWeights biases the draw: a placement's weight is the product of its
+// cells' weights, and a fleet comes up in proportion to the product of its
+// placements' weights. All weights 1 (the default) is uniform. That's only
+// so for the draws; the search ignores the weights.
+
+class PlacementSampler
+{
+  public:
+    struct Placement
+    {
+        Point topOrLeft;
+        Direction dir;
+    };
+
+    PlacementSampler(const Game& g);
+      // One weight per cell, indexed r * cols + c; they must be positive
+    void setCellWeights(const std::vector<double>& weights);
+      // Fills in one placement per ship; false if the fleet can't be placed
+    bool sample(Placement* fleet);
+      // Samples a fleet and puts it on the board
+    bool place(Board& b);
+
+  private:
+    struct Option
+    {
+        Bitboard cells;
+        Placement where;
+    };
+
+    bool search(int ship, Bitboard used, Placement* fleet, long long& budget);
+    int draw(int ship) const;
+
+    const Game& m_game;
+    std::vector<std::vector<Option> > m_options;     // by ship
+    std::vector<std::vector<double> > m_cumulative;  // by ship; empty when unweighted
+    bool m_impossible;    // the search proved no fleet fits
+};
+
+#endif // PLACEMENTSAMPLER_INCLUDED
@@ -2,26 +2,87 @@
 #include "Board.h"
 #include "Game.h"
 #include "globals.h"
+#include "GameLoop.h"
+#include "OpeningBook.h"
+#include "PlacementSampler.h"
+#include "Knowledge.h"
+#include "Bitboard.h"
+#include "Pondering.h"
+#include "Mcts.h"
+#include "Learned.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <string>
-#include <stack>
+#include <vector>
 #include <map>
 
 using namespace std;
 
+void Player::recordShotPending(Point /* p */)
+{
+      // Players that don't mind repeating themselves needn't keep track
+}
+
+// Cells waiting to be shot at, most urgent first. It lives in a fixed array,
+// so pushing during a game never goes to the allocator. Each cell is pushed
+// to the back at most once between clears. Pushes to the front may repeat a
+// cell; if the array is full, one pushes the last cell out, and one to the
+// back is dropped -- either way the cell is only lost until the next refill.
+class Frontier
+{
+  public:
+    Frontier() : m_head(0), m_size(0) {}
+    void clear() { m_head = m_size = 0; m_queued = Bitboard(); }
+    bool empty() const { return m_size == 0; }
+    void pushBack(Point p)
+    {
+        if (m_queued.test(p.r, p.c) || m_size == CAPACITY)
+            return;
+        m_queued.set(p.r, p.c);
+        m_cells[(m_head + m_size++) % CAPACITY] = p;
+    }
+    void pushFront(Point p)
+    {
+        if (m_size == CAPACITY)
+            m_size--;
+        m_queued.set(p.r, p.c);
+        m_head = (m_head + CAPACITY - 1) % CAPACITY;
+        m_cells[m_head] = p;
+        m_size++;
+    }
+    Point popFront()
+    {
+        Point p = m_cells[m_head];
+        m_head = (m_head + 1) % CAPACITY;
+        m_size--;
+        return p;
+    }
+
+  private:
+    static const int CAPACITY = 3 * MAXROWS * MAXCOLS;
+    Point m_cells[CAPACITY];
+    int m_head, m_size;
+    Bitboard m_queued;
+};
+
 //*********************************************************************
 //  AwfulPlayer
 //*********************************************************************
 
-class AwfulPlayer : public Player
+class AwfulPlayer final : public Player
 {
   public:
     AwfulPlayer(string nm, const Game& g);
+    virtual const char* type() const { return "awful"; }
     virtual bool placeShips(Board& b);
     virtual Point recommendAttack();
     virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
                                                 bool shipDestroyed, int shipId);
     virtual void recordAttackByOpponent(Point p);
+    virtual void resetForNewGame();
   private:
     Point m_lastCellAttacked;
 };
@@ -66,6 +127,12 @@ void AwfulPlayer::recordAttackByOpponent(Point /* p */)
       // AwfulPlayer completely ignores what the opponent does
 }
 
+void AwfulPlayer::resetForNewGame()
+{
+      // Start the sweep from the bottom right corner again
+    m_lastCellAttacked = Point(0, 0);
+}
+
 //*********************************************************************
 //  HumanPlayer
 //*********************************************************************
@@ -85,6 +152,7 @@ class HumanPlayer: public Player
 public:
     HumanPlayer(string nm, const Game& g): Player(nm, g), m_lastCellAttacked(0,0), m_name(nm){};
     virtual bool isHuman() const {return true;}
+    virtual const char* type() const {return "human";}
     virtual bool placeShips(Board& b);
     virtual Point recommendAttack();
     virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
@@ -189,33 +257,32 @@ void HumanPlayer::recordAttackByOpponent(Point /* p */)
 //  MediocrePlayer
 //*********************************************************************
 
-class MediocrePlayer: public Player
+class MediocrePlayer final : public Player
 {
 public:
-    MediocrePlayer(string nm, const Game& g): Player(nm, g), m_lastCellAttacked(0,0), m_name(nm), m_state(1){
-        // Make sure the stack initializes empty
-        while (!m_recall.empty())
-            m_recall.pop();
+    MediocrePlayer(string nm, const Game& g, const StrategyParams& params): Player(nm, g), m_lastCellAttacked(0,0), m_name(nm), m_state(1), m_placer(g), m_params(params){
+        // There can't be more valid attacks than cells
+        attackLog.reserve(g.rows() * g.cols());
+        m_pending.reserve(g.rows() * g.cols());
     }
     // Destructor to sensure space for struct and vector are released.
     virtual ~MediocrePlayer()
     {
-        while (!m_recall.empty())
-            m_recall.pop();
         while (!attackLog.empty())
             attackLog.pop_back();
     }
+    virtual const char* type() const {return "mediocre";}
     virtual bool placeShips(Board& b);
     virtual Point recommendAttack();
     virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
                                                 bool shipDestroyed, int shipId);
     virtual void recordAttackByOpponent(Point p);
-    // Helper Function
-    bool placedShips(Point p, int shipId, Board& b);
+    virtual void recordShotPending(Point p);
+    virtual void resetForNewGame();
     class logAttacks{
     public:
         logAttacks(Point p, bool shotHit, bool shipDestroyed, int shipId): mp(p), m_hit(shotHit), m_destroy(shipDestroyed), m_shipId(shipId){};
-        Point attackPoint(){return mp;}
+        Point attackPoint() const {return mp;}
         bool attackHit(){return m_hit;}
         bool attackDestroy(){return m_destroy;}
         int shipIdentify(){return m_shipId;}
@@ -227,109 +294,63 @@ public:
     vector <logAttacks> attackLog;
     
 private:
+    // Whether p has been shot at, or picked earlier in this salvo
+    bool attacked(Point p) const;
+    // Whether anything within mediocreJump of the centre is left to try
+    bool crossOpen() const;
     Point m_lastCellAttacked;
     string m_name;
     int m_state;
-    stack<Point> m_recall;
     Point m_Center;
+    PlacementSampler m_placer;
+    StrategyParams m_params;
+    // Shots picked this turn whose results haven't come in yet
+    vector<Point> m_pending;
 };
 
-bool MediocrePlayer::placedShips(Point p, int shipId, Board& b){
-    // Return true if at the last ship
-    if (shipId == game().nShips())
-        return true;
-    
-    // "Layering technique"
-    if (p.c == game().cols()){
-        // Adjust the column to the first position and move the row down one
-        p.c = 0;
-        p.r++;
-    }
-    
-    // IF we can place the ship HORIZONTALLY at point p
-    if (b.placeShip(Point(p.r, p.c), shipId, HORIZONTAL)){
-        // Log the point
-        m_recall.push(Point(p.r, p.c));
-        // Start from top again
-        //p.r = 0;
-        //p.c = 0;
-        if (placedShips(Point(p.r, p.c), shipId+1, b))
+bool MediocrePlayer::placeShips(Board &b){
+    // A uniformly random fleet; fails straight away if there's no room for one
+    return m_placer.place(b);
+}
+
+bool MediocrePlayer::attacked(Point p) const{
+    for (size_t i = 0; i < attackLog.size(); i++)
+        if (p.r == attackLog[i].attackPoint().r && p.c == attackLog[i].attackPoint().c)
             return true;
-        // IF another ship couldn't be placed BACKTRACK
-        b.unplaceShip(m_recall.top(), shipId, HORIZONTAL);
-        if (!m_recall.empty())
-            m_recall.pop();
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
-    
-    // IF we can place the ship VERTICALLY at point p
-    if (b.placeShip(Point(p.r, p.c), shipId, VERTICAL)){
-        // Log the point
-        m_recall.push(Point(p.r, p.c));
-        // Start from top again
-        //p.r = 0;
-        //p.c = 0;
-        if (placedShips(Point(p.r, p.c), shipId+1, b))
+    for (size_t i = 0; i < m_pending.size(); i++)
+        if (p.r == m_pending[i].r && p.c == m_pending[i].c)
             return true;
-        // IF another ship couldn't be placed BACKTRACK
-        b.unplaceShip(m_recall.top(), shipId, VERTICAL);
-        if (!m_recall.empty())
-            m_recall.pop();
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
-    
-    // IF we cannot place the ship HORIZONTALLY/VETICALLY move the point and try here
-    else {
-        // If we have reached the end of the grid then we cannot place the ship
-        if (p.r == game().rows())
-            // At this point the "layering technique" states that all spaces have been attempted. Thus it is impossible to place this ship.
-            return false;
-        
-        // Otherwise it's within the bounds of the grid so test the new point.
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
+    return false;
 }
 
-bool MediocrePlayer::placeShips(Board &b){
-    // Try different variations until count is 50
-    for (int count = 0; count < 50; count++){
-        // Block some parts
-        b.block();
-        // IF all the ships can be placed return true;
-        if (placedShips(Point(0,0), 0, b)){
-            // Make sure to unblock before you return true
-            b.unblock();
-            
-            // Make sure we get rid of allocated stack before we return
-            while (!m_recall.empty())
-                m_recall.pop();
-            return true;
-        }
-        
-        // If the ships couldn't be placed try a different block
-        b.unblock();
+bool MediocrePlayer::crossOpen() const{
+    if (!attacked(m_Center))
+        return true;
+    for (int k = 1; k <= m_params.mediocreJump; k++){
+        Point around[4] = { Point(max(m_Center.r - k, 0), m_Center.c), Point(m_Center.r, min(m_Center.c + k, game().cols() - 1)),
+                            Point(min(m_Center.r + k, game().rows() - 1), m_Center.c), Point(m_Center.r, max(m_Center.c - k, 0)) };
+        for (int d = 0; d < 4; d++)
+            if (!attacked(around[d]))
+                return true;
     }
-    // Make sure we get rid of allocated stack before we return
-    while (!m_recall.empty())
-        m_recall.pop();
-    
-    // Return false -- unable to put any in
     return false;
 }
 
 Point MediocrePlayer::recommendAttack(){
+    // A jump too short to reach the rest of the ship would search forever;
+    // give up on it and go back to random shots
+    if (m_state == 2 && !crossOpen())
+        m_state = 1;
+    // Late in a salvo every cell can be taken; this will just be a wasted shot
+    if (attackLog.size() + m_pending.size() >= size_t(game().rows() * game().cols()))
+        return m_lastCellAttacked;
     // State 1
     if (m_state == 1){
         // Find a random point
         Point rand = game().randomPoint();
-        // Search for unoriginality
-        for (int i = 0; i < attackLog.size(); i++){
-            // Try a new random point
-            if (rand.r == attackLog[i].attackPoint().r && rand.c == attackLog[i].attackPoint().c){
-                rand = game().randomPoint();
-                i = -1;
-            }
-        }
+        // Search for unoriginality -- try a new random point
+        while (attacked(rand))
+            rand = game().randomPoint();
         
         // Otherwise it is original!
         m_lastCellAttacked = rand;
@@ -338,45 +359,41 @@ Point MediocrePlayer::recommendAttack(){
     if (m_state == 2){
         Point curr = m_Center;
         
-        // Search for unoriginality
-        for (int i = 0; i < attackLog.size(); i++){
-            // If a repeat
-            if (curr.r == attackLog[i].attackPoint().r && curr.c == attackLog[i].attackPoint().c){
-                // Reset curr to original center
-                curr = m_Center;
-                // Try a new point:
-                // Go in a random direction
-                int dir = randInt(4);
-                switch (dir){
-                        // UP
-                    case 0:
-                        // Move up a random amount up to 4 UPWARDS -- if this exceeds the bounds assume the latter
-                        curr.r += - 1 - randInt(4);
-                        if (curr.r < 0)
-                            curr.r = 0;
-                        break;
-                        // RIGHT
-                    case 1:
-                        curr.c += 1 + randInt(4);
-                        if (curr.c >= game().cols())
-                            curr.c = game().cols()-1;
-                        break;
-                        // DOWN
-                    case 2:
-                        curr.r += 1 + randInt(4);
-                        if (curr.r >= game().rows())
-                            curr.r = game().rows()-1;
-                        break;
-                        // LEFT
-                    case 3:
-                        curr.c += -1 -randInt(4);
-                        if (curr.c < 0)
-                            curr.c = 0;
-                        break;
-                    default:
-                        break;
-                }
-                i = -1;
+        // Search for unoriginality -- while a repeat
+        while (attacked(curr)){
+            // Reset curr to original center
+            curr = m_Center;
+            // Try a new point:
+            // Go in a random direction
+            int dir = randInt(4);
+            switch (dir){
+                    // UP
+                case 0:
+                    // Move up a random amount up to mediocreJump UPWARDS -- if this exceeds the bounds assume the latter
+                    curr.r += - 1 - randInt(m_params.mediocreJump);
+                    if (curr.r < 0)
+                        curr.r = 0;
+                    break;
+                    // RIGHT
+                case 1:
+                    curr.c += 1 + randInt(m_params.mediocreJump);
+                    if (curr.c >= game().cols())
+                        curr.c = game().cols()-1;
+                    break;
+                    // DOWN
+                case 2:
+                    curr.r += 1 + randInt(m_params.mediocreJump);
+                    if (curr.r >= game().rows())
+                        curr.r = game().rows()-1;
+                    break;
+                    // LEFT
+                case 3:
+                    curr.c += -1 -randInt(m_params.mediocreJump);
+                    if (curr.c < 0)
+                        curr.c = 0;
+                    break;
+                default:
+                    break;
             }
         }
         
@@ -391,6 +408,9 @@ Point MediocrePlayer::recommendAttack(){
 
 void MediocrePlayer::recordAttackResult(Point p, bool validShot, bool shotHit, bool shipDestroyed, int shipId)
 {
+    // The results are in, so nothing is pending any more
+    m_pending.clear();
+
     // If an invalid shot
     if (!validShot)
         return;
@@ -427,32 +447,43 @@ void MediocrePlayer::recordAttackByOpponent(Point /* p */)
       // MediocrePlayer completely ignores what the opponent does
 }
 
+void MediocrePlayer::recordShotPending(Point p)
+{
+    m_pending.push_back(p);
+}
+
+void MediocrePlayer::resetForNewGame()
+{
+    // Forget the last game -- clear() keeps the reserved capacity so this doesn't free anything
+    attackLog.clear();
+    m_pending.clear();
+    m_state = 1;
+    m_lastCellAttacked = Point(0,0);
+}
+
 
 
 //*********************************************************************
 //  GoodPlayer
 //*********************************************************************
 
-class GoodPlayer: public Player
+class GoodPlayer final : public Player
 {
 public:
-    GoodPlayer(string nm, const Game& g): Player(nm, g), m_lastCellAttacked(0,0), m_state(1), m_countDiagnol(0){
-        while (!m_nextOne.empty())
-            m_nextOne.pop();
-        while (!m_recall.empty())
-            m_recall.pop();
-    }
-    ~GoodPlayer(){
-        while (!m_nextOne.empty())
-            m_nextOne.pop();
-        while (!m_recall.empty())
-            m_recall.pop();
+    GoodPlayer(string nm, const Game& g, const StrategyParams& params): Player(nm, g), m_lastCellAttacked(0,0), m_state(1), m_placer(g), m_knowledge(g), m_params(params){
+        openBook();
+        // There can't be more valid attacks than cells
+        attackLog.reserve(g.rows() * g.cols());
     }
+    ~GoodPlayer(){}
+    virtual const char* type() const {return "good";}
     virtual bool placeShips(Board& b);
     virtual Point recommendAttack();
     virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
                                                 bool shipDestroyed, int shipId);
     virtual void recordAttackByOpponent(Point p);
+    virtual void recordShotPending(Point p);
+    virtual void resetForNewGame();
     // Helper class
     class logAttacks{
     public:
@@ -468,265 +499,200 @@ public:
     };
     vector <logAttacks> attackLog;
     // Helper Function
-    bool diagLeft();
-    bool placedShips(Point p, int shipId, Board& b);
+    // Queues the cells worth trying next to a hit
+    void addNeighbours(Point p);
+    // Starts the frontier over from the hits still worth chasing
+    void refillFrontier();
+    bool worthTrying(Point p) const;
+    // Picks up the shared opening book, if it fits this game
+    void openBook();
 private:
     Point m_lastCellAttacked;
-    stack<Point> m_nextOne;
-    stack<Point> m_recall;
-    int m_state, m_countDiagnol;
+    Frontier m_frontier;
+    int m_state;
+    PlacementSampler m_placer;
+    Knowledge m_knowledge;
+    StrategyParams m_params;
+    // Opening book: null once we've left it
+    const OpeningBook* m_book;
+    uint64_t m_bookHash;
+    // Shots picked this turn whose results haven't come in yet
+    Bitboard m_pending;
 };
 
-bool GoodPlayer::placedShips(Point p, int shipId, Board& b){
-    // Return true if at the last ship
-    if (shipId == game().nShips())
-        return true;
-    
-    // "Layering technique"
-    if (p.c == game().cols()){
-        // Adjust the column to the first position and move the row down one
-        p.c = 0;
-        p.r++;
-    }
-    
-    // IF we can place the ship HORIZONTALLY at point p
-    if (b.placeShip(Point(p.r, p.c), shipId, HORIZONTAL)){
-        // Log the point
-        m_recall.push(Point(p.r, p.c));
-        // Start from top again
-        //p.r = 0;
-        //p.c = 0;
-        if (placedShips(Point(p.r, p.c), shipId+1, b))
-            return true;
-        // IF another ship couldn't be placed BACKTRACK
-        b.unplaceShip(m_recall.top(), shipId, HORIZONTAL);
-        m_recall.pop();
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
-    
-    // IF we can place the ship VERTICALLY at point p
-    if (b.placeShip(Point(p.r, p.c), shipId, VERTICAL)){
-        // Log the point
-        m_recall.push(Point(p.r, p.c));
-        // Start from top again
-        //p.r = 0;
-        //p.c = 0;
-        if (placedShips(Point(p.r, p.c), shipId+1, b))
-            return true;
-        // IF another ship couldn't be placed BACKTRACK
-        b.unplaceShip(m_recall.top(), shipId, VERTICAL);
-        m_recall.pop();
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
-    
-    // IF we cannot place the ship HORIZONTALLY/VETICALLY move the point and try here
-    else {
-        // If we have reached the end of the grid then we cannot place the ship
-        if (p.r == game().rows())
-            // At this point the "layering technique" states that all spaces have been attempted. Thus it is impossible to place this ship.
-            return false;
-        
-        // Otherwise it's within the bounds of the grid so test the new point.
-        return placedShips(Point(p.r, p.c + 1), shipId, b);
-    }
+void GoodPlayer::openBook(){
+    m_book = OpeningBook::shared();
+    if (m_book != nullptr && !m_book->matches(game()))
+        m_book = nullptr;
+    m_bookHash = OpeningBook::START;
 }
 
-// We will block the board. Attempt to place a ship. Then unblock and place the next ship
 bool GoodPlayer::placeShips(Board &b){
-    // Try different variations until count is 100
-    for (int count = 0; count < 100; count++){
-        // Block some parts
-        b.block();
-        // IF all the ships can be placed return true;
-        if (placedShips(Point(0,0), 0, b)){
-            // Make sure to unblock before you return true
-            b.unblock();
-            
-            // Make sure we get rid of allocated stack before we return
-            while (!m_recall.empty())
-                m_recall.pop();
-            return true;
+    // A uniformly random fleet; fails straight away if there's no room for one
+    return m_placer.place(b);
+}
+
+bool GoodPlayer::worthTrying(Point p) const{
+    return game().isValid(p) && !m_knowledge.tried(p) && !m_pending.test(p.r, p.c) && m_knowledge.placements(p) > 0;
+}
+
+void GoodPlayer::addNeighbours(Point p){
+    static const int dr[2] = { 0, 1 }, dc[2] = { 1, 0 };
+    bool locked = false;
+    for (int axis = 0; axis < 2; axis++){
+        Point before(p.r - dr[axis], p.c - dc[axis]);
+        Point after(p.r + dr[axis], p.c + dc[axis]);
+        bool hitBefore = game().isValid(before) && m_knowledge.openHit(before);
+        bool hitAfter = game().isValid(after) && m_knowledge.openHit(after);
+        if (!hitBefore && !hitAfter)
+            continue;
+        // Two hits in a row: the ship lies along this axis, so go straight
+        // to the two ends of the run of hits
+        locked = true;
+        while (game().isValid(before) && m_knowledge.openHit(before))
+            before = Point(before.r - dr[axis], before.c - dc[axis]);
+        while (game().isValid(after) && m_knowledge.openHit(after))
+            after = Point(after.r + dr[axis], after.c + dc[axis]);
+        if (worthTrying(before))
+            m_frontier.pushFront(before);
+        if (worthTrying(after))
+            m_frontier.pushFront(after);
+        if (worthTrying(before) || worthTrying(after))
+            continue;
+        // Both ends are done with, so the run is more than one ship lying
+        // side by side: try beside each of its hits
+        for (Point q(before.r + dr[axis], before.c + dc[axis]); q.r != after.r || q.c != after.c;
+                q = Point(q.r + dr[axis], q.c + dc[axis])){
+            Point side[2] = { Point(q.r - dc[axis], q.c - dr[axis]), Point(q.r + dc[axis], q.c + dr[axis]) };
+            for (int k = 0; k < 2; k++)
+                if (worthTrying(side[k]))
+                    m_frontier.pushBack(side[k]);
         }
-        
-        // If the ships couldn't be placed try a different block
-        b.unblock();
-    }
-    
-    // IF unable to place the mediocre way...
-    int i = 0;
-    for (; i < game().nShips(); i++){
-        Point rand = game().randomPoint();
-        // If you can place the ship one of two ways
-        if (!b.placeShip(rand, i, HORIZONTAL) && !b.placeShip(rand, i, VERTICAL))
-            i--;
     }
-    
-    if (i == game().nShips())
-        return true;
-    
-    
-    // Make sure we get rid of allocated stack before we return
-    while (!m_recall.empty())
-        m_recall.pop();
-    
-    // Return false -- unable to put any in
-    return false;
-    
+    if (locked)
+        return;
+    // A lone hit: the ship could go any way from here
+    Point around[4] = { Point(p.r-1, p.c), Point(p.r, p.c+1), Point(p.r+1, p.c), Point(p.r, p.c-1) };
+    int first = randInt(4);
+    for (int k = 0; k < 4; k++)
+        if (worthTrying(around[(first + k) % 4]))
+            m_frontier.pushBack(around[(first + k) % 4]);
 }
 
-bool GoodPlayer::diagLeft(){
-    // Go through the attackLog and see if all evens have been taken
-    int diagCount = 0;
-    for (int i = 0; i < attackLog.size(); i++){
-        if ((attackLog[i].attackPoint().r + attackLog[i].attackPoint().c) % 2 == 0)
-            diagCount++;
-    }
-    
-    // IF all diagnols have been attacked
-    if (diagCount >= (game().rows() * game().cols())/2)
-        return false;
-    
-    return true;
+void GoodPlayer::refillFrontier(){
+    m_frontier.clear();
+    for (size_t i = 0; i < attackLog.size(); i++)
+        if (attackLog[i].attackHit() && m_knowledge.openHit(attackLog[i].attackPoint()))
+            addNeighbours(attackLog[i].attackPoint());
 }
 
 Point GoodPlayer::recommendAttack(){
-    // State 1 -- HASN'T hit anything
-    if (m_state == 1){
-        // If there are no diagnols left
-        if (!diagLeft()){
-            Point tryPoint = game().randomPoint();
-            for (int i = 0; i < attackLog.size(); i++){
-                // IF it is not original -- but it was already a diagnol
-                if (tryPoint.r == attackLog[i].attackPoint().r && tryPoint.c == attackLog[i].attackPoint().c){
-                    tryPoint = game().randomPoint();
-                    i = -1;
-                }
-            }
-            m_lastCellAttacked = tryPoint;
-        }
-        
-        // If there are still loggable attacks
-        else if (!m_nextOne.empty()){
-            m_state = 2;
-        }
-        
-        else {
-            // Choose from the diagnols at a random -- i + j has to be divisible by 2
-            Point tryPoint = game().randomPoint();
-        
-            while ((tryPoint.r + tryPoint.c) % 2 != 0)
-                // Try another point
-                tryPoint = game().randomPoint();
-        
-            // Search for unoriginality
-            for (int i = 0; i < attackLog.size(); i++){
-                // While it's not a "proper diagnol point"
-                while ((tryPoint.r + tryPoint.c) % 2 != 0){
-                    // Try another point
-                    tryPoint = game().randomPoint();
-                }
-            
-                // IF it is not original -- but it was already a diagnol
-                if (tryPoint.r == attackLog[i].attackPoint().r && tryPoint.c == attackLog[i].attackPoint().c){
-                    tryPoint = game().randomPoint();
-                    i = -1;
-                }
-            }
-            // This is an original diagnol point!
-            m_lastCellAttacked = tryPoint;
+    // Early on the book knows best
+    if (m_book != nullptr){
+        Point p;
+        // A damaged book, or another position's move under the same hash,
+        // could name a cell that's no use; leave the book then
+        if (m_book->probe(m_bookHash, p) && worthTrying(p)){
+            m_lastCellAttacked = p;
+            return p;
         }
+        m_book = nullptr;
     }
-    // State 2
+    
+    // State 2 -- chasing hits: the front of the frontier is the best bet
     if (m_state == 2){
-        bool tu = false, tr = false, td = false, tl = false;
-        Point curr;
-        if (!m_nextOne.empty())
-            curr = m_nextOne.top();
-        if (m_nextOne.empty())
-            curr = game().randomPoint();
-        
-        // Search for unoriginality
-        for (int i = 0; i < attackLog.size(); i++){
-            // If a repeat
-            if (curr.r == attackLog[i].attackPoint().r && curr.c == attackLog[i].attackPoint().c){
-                // If all directions were tried...
-                if (tu == true && tr == true && td == true && tl == true){
-                    // Pop the top (can't go in this direction)
-                    if (!m_nextOne.empty())
-                        m_nextOne.pop();
-                    tu = false;
-                    tr = false;
-                    td = false;
-                    tl = false;
-                }
-                
-                if (!m_nextOne.empty())
-                    curr = m_nextOne.top();
-                if (m_nextOne.empty())
-                    curr = game().randomPoint();
-                // Try a new point:
-                // Go in a random direction
-                int dir = randInt(4);
-                switch (dir){
-                        // UP
-                    case 0:
-                        // Move up a random amount up to 4 UPWARDS -- if this exceeds the bounds assume the latter
-                        curr.r -= 1;
-                        if (curr.r < 0)
-                            curr.r = 0;
-                        tu = true;
-                        break;
-                        // RIGHT
-                    case 1:
-                        curr.c += 1;
-                        if (curr.c >= game().cols())
-                            curr.c = game().cols()-1;
-                        tr = true;
-                        break;
-                        // DOWN
-                    case 2:
-                        curr.r += 1;
-                        if (curr.r >= game().rows())
-                            curr.r = game().rows()-1;
-                        td = true;
-                        break;
-                        // LEFT
-                    case 3:
-                        curr.c -=1;
-                        if (curr.c < 0)
-                            curr.c = 0;
-                        tl = true;
-                        break;
-                    default:
-                        break;
+        for (int pass = 0; pass < 2; pass++){
+            while (!m_frontier.empty()){
+                Point p = m_frontier.popFront();
+                // The frontier can hold cells that have been tried since, or
+                // that the knowledge has ruled out
+                if (worthTrying(p)){
+                    m_lastCellAttacked = p;
+                    return p;
                 }
-                i = -1;
             }
+            refillFrontier();
         }
-        
-        // Shoot it here
-        m_lastCellAttacked = curr;
-        
+        // Nothing left next to any hit
+        m_state = 1;
     }
 
+    // State 1 -- hunting: a random untried cell on every huntSpacing-th
+    // diagonal (every other one by default, since every ship is at least two
+    // long and must cover one of them). Cells no ship can be on any more
+    // aren't worth a shot.
+    Bitboard untried, possible, diagonals;
+    for (int r = 0; r < game().rows(); r++)
+        for (int c = 0; c < game().cols(); c++){
+            if (m_knowledge.tried(Point(r, c)) || m_pending.test(r, c))
+                continue;
+            untried.set(r, c);
+            if (m_knowledge.placements(Point(r, c)) == 0)
+                continue;
+            possible.set(r, c);
+            if ((r + c) % m_params.huntSpacing == m_params.huntPhase)
+                diagonals.set(r, c);
+        }
+    Bitboard choices = diagonals.any() ? diagonals : possible.any() ? possible : untried;
+    if (choices.empty()){
+        // Nowhere left to shoot; this will just be a wasted shot
+        m_lastCellAttacked = Point(0,0);
+        return m_lastCellAttacked;
+    }
+    int cell;
+    if (m_params.densityExponent == 0){
+        for (int n = randInt(choices.count()); n > 0; n--)
+            choices.popFirst();
+        cell = choices.first();
+    }
+    else{
+        // Likelier where more of the ships could be
+        double weight[MAXROWS * MAXCOLS];
+        double total = 0;
+        for (Bitboard b = choices; b.any(); ){
+            int i = b.popFirst();
+            int n = max(m_knowledge.placements(Point(i / MAXCOLS, i % MAXCOLS)), 1);
+            weight[i] = pow((double)n, m_params.densityExponent);
+            total += weight[i];
+        }
+        double x = uniform_real_distribution<double>(0, total)(randomGenerator());
+        for (cell = choices.first(); choices.any(); ){
+            cell = choices.popFirst();
+            x -= weight[cell];
+            if (x < 0)
+                break;
+        }
+    }
+    m_lastCellAttacked = Point(cell / MAXCOLS, cell % MAXCOLS);
     return m_lastCellAttacked;
-    
 }
 
 void GoodPlayer::recordAttackResult(Point p, bool validShot, bool shotHit, bool shipDestroyed, int shipId){
+    // The results are in, so nothing is pending any more
+    m_pending = Bitboard();
+
     // If an invalid shot
     if (!validShot)
         return;
 
     // Log this attack as successful
     attackLog.push_back(logAttacks(p, shotHit, shipDestroyed, shipId));
+    m_knowledge.record(p, shotHit, shipDestroyed, shipId);
+    
+    // The book only knows about misses and hits
+    if (m_book != nullptr){
+        if (shipDestroyed)
+            m_book = nullptr;
+        else
+            m_bookHash ^= OpeningBook::zobrist(Bitboard::index(p.r, p.c), shotHit);
+    }
     
     // State 1
     if (m_state == 1){
         // IF the shot hits but DOES NOT destroy the ship
         if (shotHit == true && shipDestroyed == false){
             // This is the center of the cross search
-            m_nextOne.push(attackLog[attackLog.size()-1].attackPoint());
+            addNeighbours(p);
             m_state = 2;
         }
         // Otherwise do nothing
@@ -735,10 +701,14 @@ void GoodPlayer::recordAttackResult(Point p, bool validShot, bool shotHit, bool
     // State 2
     else if (m_state == 2){
         if (shotHit == true && shipDestroyed == false)
-            m_nextOne.push(attackLog[attackLog.size()-1].attackPoint());
-        // If the shot hits and destroys the ship
-        if (shotHit == true && shipDestroyed == true)
-            m_state = 1;
+            addNeighbours(p);
+        // If the shot hits and destroys the ship, the hits it accounts for
+        // are done with -- keep chasing only the ones that aren't
+        if (shotHit == true && shipDestroyed == true){
+            refillFrontier();
+            if (m_frontier.empty())
+                m_state = 1;
+        }
         // Otherwise do nothing
         return;
     }
@@ -751,30 +721,223 @@ void GoodPlayer::recordAttackByOpponent(Point /* p */){
     
 }
 
+void GoodPlayer::recordShotPending(Point p){
+    m_pending.set(p.r, p.c);
+    // The book's position only moves on with results, so it would hand out
+    // this cell again for the next shot of the salvo; it's for one shot a
+    // turn, so leave it
+    m_book = nullptr;
+}
+
+void GoodPlayer::resetForNewGame(){
+    // Forget the last game -- clear() keeps the reserved capacity so this doesn't free anything
+    attackLog.clear();
+    m_frontier.clear();
+    m_state = 1;
+    m_lastCellAttacked = Point(0,0);
+    m_knowledge.reset();
+    m_pending = Bitboard();
+    openBook();
+}
+
+//*********************************************************************
+//  StrategyParams
+//*********************************************************************
+
+static const char* paramNames[] = {
+    "mediocreJump", "huntSpacing", "huntPhase", "densityExponent"
+};
+
+vector<string> StrategyParams::names()
+{
+    return vector<string>(paramNames, paramNames + sizeof(paramNames)/sizeof(paramNames[0]));
+}
+
+double StrategyParams::get(const string& name) const
+{
+    if (name == "mediocreJump")
+        return mediocreJump;
+    if (name == "huntSpacing")
+        return huntSpacing;
+    if (name == "huntPhase")
+        return huntPhase;
+    if (name == "densityExponent")
+        return densityExponent;
+    return 0;
+}
+
+bool StrategyParams::set(const string& name, double value)
+{
+    int whole = (int)floor(value + 0.5);
+    if (name == "mediocreJump")
+        mediocreJump = max(whole, 1);
+    else if (name == "huntSpacing")
+        huntSpacing = max(whole, 1);
+    else if (name == "huntPhase")
+        huntPhase = max(whole, 0);
+    else if (name == "densityExponent")
+        densityExponent = value;
+    else
+        return false;
+    return true;
+}
+
+void StrategyParams::normalize()
+{
+    // The phase only means something up to the spacing
+    huntPhase %= huntSpacing;
+}
+
+string StrategyParams::str() const
+{
+    ostringstream out;
+    vector<string> all = names();
+    for (size_t k = 0; k < all.size(); k++)
+        out << (k == 0 ? "" : ",") << all[k] << "=" << get(all[k]);
+    return out.str();
+}
+
+bool StrategyParams::parse(const string& s)
+{
+    StrategyParams p = *this;
+    istringstream in(s);
+    string item;
+    while (getline(in, item, ',')){
+        size_t eq = item.find('=');
+        if (eq == string::npos)
+            return false;
+        const char* value = item.c_str() + eq + 1;
+        char* end;
+        double v = strtod(value, &end);
+        if (end == value || *end != '\0' || !p.set(item.substr(0, eq), v))
+            return false;
+    }
+    p.normalize();
+    *this = p;
+    return true;
+}
+
 //*********************************************************************
 //  createPlayer
 //*********************************************************************
 
+static string types[] = {
+    "human", "awful", "mediocre", "good", "learned", "mcts"
+};
+
+vector<string> playerTypes()
+{
+    return vector<string>(types, types + sizeof(types)/sizeof(types[0]));
+}
+
 Player* createPlayer(string type, string nm, const Game& g)
 {
-    static string types[] = {
-        "human", "awful", "mediocre", "good"
-    };
-    
+    // "ponder-<type>" thinks about its next shot during the opponent's turn
+    const string ponder = "ponder-";
+    if (type.compare(0, ponder.size(), ponder) == 0){
+        Player* inner = createPlayer(type.substr(ponder.size()), nm, g);
+        return inner == nullptr ? nullptr : new PonderingPlayer(inner, type);
+    }
+
+    StrategyParams params;
+    size_t colon = type.find(':');
+    if (colon != string::npos){
+        if (!params.parse(type.substr(colon + 1)))
+            return nullptr;
+        type = type.substr(0, colon);
+    }
     int pos;
     for (pos = 0; pos != sizeof(types)/sizeof(types[0])  &&
                                                      type != types[pos]; pos++)
         ;
+    // Only mediocre and good play by StrategyParams; any others given them
+    // would quietly ignore them
+    if (colon != string::npos && pos != 2 && pos != 3)
+        return nullptr;
     switch (pos)
     {
       case 0:  return new HumanPlayer(nm, g);
       case 1:  return new AwfulPlayer(nm, g);
-      case 2:  return new MediocrePlayer(nm, g);
-      case 3:  return new GoodPlayer(nm, g);
+      case 2:  return new MediocrePlayer(nm, g, params);
+      case 3:  return new GoodPlayer(nm, g, params);
+      case 4:  return new LearnedPlayer(nm, g, LearnedPlayer::defaultModel());
+      case 5:  return new MctsPlayer(nm, g, MctsPlayer::defaultBudget());
       default: return nullptr;
     }
 }
 
+//*********************************************************************
+//  playDevirtualized
+//*********************************************************************
+
+// Second half of the dispatch: P1 is known, now find out what p2 is
+template<class P1>
+bool playAgainst(P1& p1, Player* p2, Board& b1, Board& b2, Player*& winner)
+{
+    if (AwfulPlayer* a = dynamic_cast<AwfulPlayer*>(p2))
+        winner = playStatic(p1, *a, b1, b2);
+    else if (MediocrePlayer* m = dynamic_cast<MediocrePlayer*>(p2))
+        winner = playStatic(p1, *m, b1, b2);
+    else if (GoodPlayer* g = dynamic_cast<GoodPlayer*>(p2))
+        winner = playStatic(p1, *g, b1, b2);
+    else
+        return false;
+    return true;
+}
+
+bool playDevirtualized(Player* p1, Player* p2, Board& b1, Board& b2, Player*& winner)
+{
+    // The casts happen once per game, not once per move
+    if (AwfulPlayer* a = dynamic_cast<AwfulPlayer*>(p1))
+        return playAgainst(*a, p2, b1, b2, winner);
+    if (MediocrePlayer* m = dynamic_cast<MediocrePlayer*>(p1))
+        return playAgainst(*m, p2, b1, b2, winner);
+    if (GoodPlayer* g = dynamic_cast<GoodPlayer*>(p1))
+        return playAgainst(*g, p2, b1, b2, winner);
+    return false;
+}
+
+//*********************************************************************
+//  PlayerPool
+//*********************************************************************
+
+PlayerPool::~PlayerPool()
+{
+    for (size_t k = 0; k < m_entries.size(); k++)
+        delete m_entries[k].player;
+}
+
+Player* PlayerPool::acquire(const string& type, const string& nm, const Game& g)
+{
+    // Reuse an idle player of the same kind if we have one
+    for (size_t k = 0; k < m_entries.size(); k++){
+        Entry& e = m_entries[k];
+        if (!e.inUse && e.type == type && &e.player->game() == &g && e.player->name() == nm){
+            e.player->resetForNewGame();
+            e.inUse = true;
+            return e.player;
+        }
+    }
+    
+    // Otherwise make a new one
+    Player* p = createPlayer(type, nm, g);
+    if (p == nullptr)
+        return nullptr;
+    Entry e;
+    e.type = type;
+    e.player = p;
+    e.inUse = true;
+    m_entries.push_back(e);
+    return p;
+}
+
+void PlayerPool::release(Player* p)
+{
+    for (size_t k = 0; k < m_entries.size(); k++)
+        if (m_entries[k].player == p)
+            m_entries[k].inUse = false;
+}
+
 
 // Tests for HumanPlayer
 /*
@@ -832,3 +995,69 @@ int main(){
     f.display(false);
 }
 */
+
+// Micro-benchmark: virtual Game::play loop vs the statically dispatched one
+/*
+#include <chrono>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier");
+    g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer");
+    g.addShip(3, 's', "submarine");
+    g.addShip(2, 'p', "patrol boat");
+    Player* p1 = createPlayer("awful", "Alpha", g);
+    Player* p2 = createPlayer("awful", "Beta", g);
+    Board b1(g), b2(g);
+    PlayOptions opts;
+    opts.quiet = true;
+    const int n = 200000;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+        g.play(p1, p2, b1, b2, opts);
+    auto t1 = chrono::steady_clock::now();
+    Player* winner;
+    for (int i = 0; i < n; i++)
+        playDevirtualized(p1, p2, b1, b2, winner);
+    auto t2 = chrono::steady_clock::now();
+    cout << "virtual: " << chrono::duration<double, micro>(t1 - t0).count() / n << " us/game" << endl;
+    cout << "static:  " << chrono::duration<double, micro>(t2 - t1).count() / n << " us/game" << endl;
+}
+*/
+
+// Salvo games: with five shots a turn every player should need about a fifth
+// of the turns, which it only does if it doesn't fire twice at one cell
+/*
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier");
+    g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer");
+    g.addShip(3, 's', "submarine");
+    g.addShip(2, 'p', "patrol boat");
+    const char* types[] = { "mediocre", "good", "learned", "mcts" };
+    for (int t = 0; t < 4; t++){
+        Player* p1 = createPlayer(types[t], "Alpha", g);
+        Player* p2 = createPlayer(types[t], "Beta", g);
+        Board b1(g), b2(g);
+        int turns[2] = { 0, 0 };
+        for (int salvo = 0; salvo < 2; salvo++){
+            for (int i = 0; i < 20; i++){
+                GameResult r;
+                PlayOptions opts;
+                opts.quiet = true;
+                opts.shotsPerTurn = salvo == 0 ? 1 : 5;
+                opts.result = &r;
+                p1->resetForNewGame();
+                p2->resetForNewGame();
+                g.play(p1, p2, b1, b2, opts);
+                turns[salvo] += r.turns;
+            }
+        }
+        cout << types[t] << ": " << turns[0] << " turns one shot at a time, "
+             << turns[1] << " five at a time" << endl;
+        delete p1;
+        delete p2;
+    }
+}
+*/
@@ -1,7 +1,10 @@
 #ifndef PLAYER_INCLUDED
 #define PLAYER_INCLUDED
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <vector>
 
 class Point;
 class Board;
@@ -11,21 +14,50 @@ class Player
 {
   public:
     Player(std::string nm, const Game& g)
-     : m_name(nm), m_game(g)
+     : m_name(nm), m_game(g), m_deadline(std::chrono::steady_clock::time_point::max().time_since_epoch().count())
     {}
 
     virtual ~Player() {}
 
-    std::string name() const { return m_name; }
+    const std::string& name() const { return m_name; }
     const Game& game() const { return m_game; }
 
     virtual bool isHuman() const { return false; }
+      // The createPlayer type name of this strategy (a string literal)
+    virtual const char* type() const { return "player"; }
 
     virtual bool placeShips(Board& b) = 0;
     virtual Point recommendAttack() = 0;
     virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
                                         bool shipDestroyed, int shipId) = 0;
     virtual void recordAttackByOpponent(Point p) = 0;
+      // In a salvo every shot of the turn is asked for before any of their
+      // results come in; this is the cell just picked, so the next pick can
+      // steer clear of it. Its result still comes through recordAttackResult.
+      // By default it's ignored.
+    virtual void recordShotPending(Point p);
+      // Forget everything learned during the previous game
+    virtual void resetForNewGame() {}
+      // When the shot being asked for is due, under time controls (see
+      // PlayOptions::moveTime); time_point::max() when there's no limit. A
+      // player that searches should stop once it's past and answer with the
+      // best shot it has found so far.
+    std::chrono::steady_clock::time_point deadline() const
+    {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(m_deadline.load(std::memory_order_relaxed)));
+    }
+    bool pastDeadline() const
+    {
+        std::chrono::steady_clock::time_point t = deadline();
+        return t != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= t;
+    }
+      // Game::play sets this before each recommendAttack. It may be moved while
+      // the player is thinking on another thread (see Pondering.h).
+    void setDeadline(std::chrono::steady_clock::time_point t)
+    {
+        m_deadline.store(t.time_since_epoch().count(), std::memory_order_relaxed);
+    }
       // We prevent any kind of Player object from being copied or assigned
     Player(const Player&) = delete;
     Player& operator=(const Player&) = delete;
@@ -33,7 +65,65 @@ class Player
   private:
     std::string m_name;
     const Game& m_game;
+    std::atomic<std::chrono::steady_clock::rep> m_deadline;
 };
 
+  // The numbers the built-in strategies play by. The defaults are how they've
+  // always played.
+struct StrategyParams
+{
+    StrategyParams() : mediocreJump(4), huntSpacing(2), huntPhase(0), densityExponent(0) {}
+    int mediocreJump;         // mediocre: farthest it strays from a hit looking for the rest of the ship
+    int huntSpacing;          // good: hunts the cells with (r + c) % huntSpacing == huntPhase
+    int huntPhase;
+    double densityExponent;   // good: picks among those by (placements through them)^this; 0 is uniform
+      // Every parameter's name, and getting and setting them by name (set
+      // rounds to a whole number where it has to, and is false for a name
+      // that isn't one of them)
+    static std::vector<std::string> names();
+    double get(const std::string& name) const;
+    bool set(const std::string& name, double value);
+      // Brings parameters that depend on each other into line (huntPhase
+      // under huntSpacing); call it once after a batch of sets, so the
+      // result doesn't depend on their order. parse does.
+    void normalize();
+      // As "name=value,name=value", listing every parameter; parse takes any
+      // of them, and is false if something doesn't make sense
+    std::string str() const;
+    bool parse(const std::string& s);
+};
+
+  // A type of "ponder-" followed by one of playerTypes() makes that player
+  // think during the opponent's turn (see Pondering.h). A type followed by
+  // ":" and some StrategyParams (say "good:densityExponent=1.5") plays by
+  // those instead of the defaults; only mediocre and good take them, and
+  // the result is nullptr for any other type given them.
 Player* createPlayer(std::string type, std::string nm, const Game& g);
+  // Every type name createPlayer knows, in the order it checks them
+std::vector<std::string> playerTypes();
+
+  // Keeps players around between games so a worker can play game after game
+  // without creating and destroying them. An acquired player has been reset
+  // for a new game; release it when the game is over. A pool is meant to be
+  // used by a single thread.
+class PlayerPool
+{
+  public:
+    PlayerPool() {}
+    ~PlayerPool();
+    Player* acquire(const std::string& type, const std::string& nm, const Game& g);
+    void release(Player* p);
+      // We prevent a PlayerPool object from being copied or assigned
+    PlayerPool(const PlayerPool&) = delete;
+    PlayerPool& operator=(const PlayerPool&) = delete;
+
+  private:
+    struct Entry
+    {
+        std::string type;
+        Player* player;
+        bool inUse;
+    };
+    std::vector<Entry> m_entries;
+};
 #endif // PLAYER_INCLUDED
@@ -0,0 +1,182 @@
+#include "Pondering.h"
+#include "globals.h"
+#include <set>
+
+using namespace std;
+
+namespace {
+
+// Traces hold on to type names after the player is gone, so each one is
+// kept for the rest of the program like the other players' literals
+const char* intern(const string& name)
+{
+    static mutex guard;
+    static set<string>* names = new set<string>;
+    lock_guard<mutex> lock(guard);
+    return names->insert(name).first->c_str();
+}
+
+} // namespace
+
+PonderingPlayer::PonderingPlayer(Player* inner, const string& type)
+ : Player(inner->name(), inner->game()), m_inner(inner), m_type(intern(type)), m_state(IDLE),
+   m_seed(0), m_outstanding(0), m_pondered(0)
+{
+    m_thread = thread(&PonderingPlayer::think, this);
+}
+
+PonderingPlayer::~PonderingPlayer()
+{
+    Point ignored;
+    finishPondering(chrono::steady_clock::now(), ignored);
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_state = QUIT;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    delete m_inner;
+}
+
+void PonderingPlayer::think()
+{
+    unique_lock<mutex> lock(m_mutex);
+    for (;;){
+        m_cv.wait(lock, [this]{ return m_state == THINKING || m_state == QUIT; });
+        if (m_state == QUIT)
+            return;
+        // Random numbers on this thread follow on from the game's, so a
+        // seeded game still plays out the same every time
+        seedRandom(m_seed);
+        lock.unlock();
+        Point shot = m_inner->recommendAttack();
+        lock.lock();
+        m_shot = shot;
+        m_state = DONE;
+        m_cv.notify_all();
+    }
+}
+
+void PonderingPlayer::startPondering()
+{
+    // Humans answer at the keyboard, not on another thread
+    if (m_inner->isHuman())
+        return;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (m_state != IDLE)     // there's a shot waiting already
+            return;
+        // No deadline until the shot is asked for
+        m_inner->setDeadline(chrono::steady_clock::time_point::max());
+        m_seed = (unsigned int)randomGenerator()();
+        m_state = THINKING;
+    }
+    m_cv.notify_all();
+}
+
+void PonderingPlayer::stopThinking(unique_lock<mutex>& lock, chrono::steady_clock::time_point by)
+{
+    if (m_state != THINKING)
+        return;
+    m_inner->setDeadline(by);
+    m_cv.wait(lock, [this]{ return m_state == DONE; });
+}
+
+bool PonderingPlayer::finishPondering(chrono::steady_clock::time_point by, Point& shot)
+{
+    unique_lock<mutex> lock(m_mutex);
+    stopThinking(lock, by);
+    if (m_state != DONE)
+        return false;
+    shot = m_shot;
+    m_state = IDLE;
+    return true;
+}
+
+bool PonderingPlayer::placeShips(Board& b)
+{
+    Point ignored;
+    finishPondering(chrono::steady_clock::now(), ignored);
+    return m_inner->placeShips(b);
+}
+
+Point PonderingPlayer::recommendAttack()
+{
+    m_outstanding++;
+    Point shot;
+    if (finishPondering(deadline(), shot)){
+        m_pondered++;
+        return shot;
+    }
+    m_inner->setDeadline(deadline());
+    return m_inner->recommendAttack();
+}
+
+void PonderingPlayer::recordAttackResult(Point p, bool validShot, bool shotHit,
+                                         bool shipDestroyed, int shipId)
+{
+    // Pondering only starts once every shot of the turn has come back, so
+    // this shouldn't find it going -- but if it does, the shot it comes up
+    // with is still the next one handed out
+    {
+        unique_lock<mutex> lock(m_mutex);
+        stopThinking(lock, chrono::steady_clock::now());
+    }
+    m_inner->recordAttackResult(p, validShot, shotHit, shipDestroyed, shipId);
+    if (m_outstanding > 0)
+        m_outstanding--;
+    if (m_outstanding == 0)
+        startPondering();
+}
+
+void PonderingPlayer::recordAttackByOpponent(Point p)
+{
+    // The wrapped player can't be told anything while it's thinking, so cut
+    // the pondering short; the shot it came up with still stands
+    {
+        unique_lock<mutex> lock(m_mutex);
+        stopThinking(lock, chrono::steady_clock::now());
+    }
+    m_inner->recordAttackByOpponent(p);
+}
+
+void PonderingPlayer::recordShotPending(Point p)
+{
+    // Nothing is pondered in the middle of a salvo, but stop to be sure
+    {
+        unique_lock<mutex> lock(m_mutex);
+        stopThinking(lock, chrono::steady_clock::now());
+    }
+    m_inner->recordShotPending(p);
+}
+
+void PonderingPlayer::resetForNewGame()
+{
+    // Whatever was being pondered was for the game that's over
+    Point ignored;
+    finishPondering(chrono::steady_clock::now(), ignored);
+    m_outstanding = 0;
+    m_inner->resetForNewGame();
+}
+
+// A pondering player against a plain one; every shot after the first should
+// have been pondered
+/*
+#include "Game.h"
+#include <iostream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    Player* p1 = createPlayer("ponder-good", "pondering", g);
+    Player* p2 = createPlayer("good", "plain", g);
+    GameResult r;
+    PlayOptions opts;
+    opts.quiet = true;
+    opts.result = &r;
+    g.play(p1, p2, opts);
+    cout << ((PonderingPlayer*)p1)->pondered() << " of " << r.shots[0] << " shots pondered" << endl;
+    delete p1;
+    delete p2;
+}
+*/
@@ -0,0 +1,68 @@
+#ifndef PONDERING_INCLUDED
+#define PONDERING_INCLUDED
+
+#include "Player.h"
+#include "globals.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Wraps a player so it thinks about its next shot while the opponent takes
+// its turn. Nothing the opponent does changes where a player should shoot
+// next, so as soon as the results of a turn's shots are in, a background
+// thread asks the wrapped player for its next shot; when Game::play asks for
+// it, it's usually there already. The wrapped player is only ever called from
+// one thread at a time.
+//
+// An anytime player (one that searches until Player::pastDeadline) keeps
+// searching through the opponent's turn and stops at the deadline of the
+// move it's pondering, so it gets the opponent's thinking time on top of its
+// own.
+//
+// A salvo is asked for all at once, so only its first shot is pondered.
+// Handing a thread to a quick player costs more than it saves; this is for
+// the expensive ones. createPlayer makes one for "ponder-<type>".
+
+class PonderingPlayer : public Player
+{
+  public:
+      // Takes over inner, and deletes it when done with it
+    PonderingPlayer(Player* inner, const std::string& type);
+    virtual ~PonderingPlayer();
+    virtual bool isHuman() const { return m_inner->isHuman(); }
+    virtual const char* type() const { return m_type; }
+    virtual bool placeShips(Board& b);
+    virtual Point recommendAttack();
+    virtual void recordAttackResult(Point p, bool validShot, bool shotHit,
+                                        bool shipDestroyed, int shipId);
+    virtual void recordAttackByOpponent(Point p);
+    virtual void recordShotPending(Point p);
+    virtual void resetForNewGame();
+      // How many shots were ready (or being worked on) when they were asked for
+    long long pondered() const { return m_pondered; }
+
+  private:
+    enum State { IDLE, THINKING, DONE, QUIT };
+
+    void think();
+    void startPondering();
+      // Has the background thread wrap up by the given time, if it's thinking
+    void stopThinking(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point by);
+      // Lets the background thread finish by the given time and waits for it;
+      // false if it wasn't pondering
+    bool finishPondering(std::chrono::steady_clock::time_point by, Point& shot);
+
+    Player* m_inner;
+    const char* m_type;     // interned, so it outlives this player like a literal
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    State m_state;
+    Point m_shot;           // the pondered shot, once it's DONE
+    unsigned int m_seed;    // for the background thread's random numbers
+    int m_outstanding;      // shots asked for whose results haven't come in
+    long long m_pondered;
+    std::thread m_thread;
+};
+
+#endif // PONDERING_INCLUDED
@@ -0,0 +1,160 @@
+#include "ShardResults.h"
+#include "Tournament.h"
+#include "Endian.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[4] = { 'B', 'S', 'H', 'D' };
+const uint64_t VERSION = 1;
+
+void putString(ostream& out, const string& s)
+{
+    writeLE(out, s.size(), 8);
+    out.write(s.data(), s.size());
+}
+
+bool getString(istream& in, string& s)
+{
+    uint64_t n;
+    // Strategy names are short; anything huge means a corrupt file
+    if (!readLE(in, n, 8) || n > 1000)
+        return false;
+    s.resize(n);
+    return n == 0 || bool(in.read(&s[0], n));
+}
+
+void bump(atomic<long long>& a, long long by)
+{
+    a.store(a.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+} // namespace
+
+ShardResults::~ShardResults()
+{
+    for (map<pair<string, string>, MatchupStats*>::iterator p = m_entries.begin(); p != m_entries.end(); p++)
+        delete p->second;
+}
+
+MatchupStats& ShardResults::entry(const string& type1, const string& type2)
+{
+    MatchupStats*& s = m_entries[make_pair(type1, type2)];
+    if (s == nullptr)
+        s = new MatchupStats;
+    return *s;
+}
+
+void ShardResults::add(const Tournament& t)
+{
+    for (int m = 0; m < t.nMatchups(); m++){
+        MatchupStats total;
+        t.merged(m, total);
+        MatchupStats& e = entry(t.matchupType(m, 0), t.matchupType(m, 1));
+        bump(e.games, total.games);
+        bump(e.failed, total.failed);
+        for (int k = 0; k < 2; k++){
+            bump(e.wins[k], total.wins[k]);
+            e.shotsToWin[k].merge(total.shotsToWin[k]);
+        }
+        e.gameLength.merge(total.gameLength);
+    }
+}
+
+bool ShardResults::load(const string& path)
+{
+    ifstream in(path.c_str(), ios::binary);
+    char magic[4];
+    uint64_t version, n;
+    if (!in.read(magic, 4) || !equal(magic, magic + 4, MAGIC) ||
+            !readLE(in, version, 8) || version != VERSION || !readLE(in, n, 8))
+        return false;
+    for (uint64_t k = 0; k < n; k++){
+        string type1, type2;
+        uint64_t games, failed, wins0, wins1;
+        if (!getString(in, type1) || !getString(in, type2) || !readLE(in, games, 8) ||
+                !readLE(in, failed, 8) || !readLE(in, wins0, 8) || !readLE(in, wins1, 8))
+            return false;
+        MatchupStats& e = entry(type1, type2);
+        bump(e.games, games);
+        bump(e.failed, failed);
+        bump(e.wins[0], wins0);
+        bump(e.wins[1], wins1);
+        if (!e.shotsToWin[0].loadAndMerge(in) || !e.shotsToWin[1].loadAndMerge(in) ||
+                !e.gameLength.loadAndMerge(in))
+            return false;
+    }
+    return true;
+}
+
+bool ShardResults::save(const string& path) const
+{
+    ofstream out(path.c_str(), ios::binary);
+    if (!out)
+        return false;
+    out.write(MAGIC, 4);
+    writeLE(out, VERSION, 8);
+    writeLE(out, m_entries.size(), 8);
+    // A map iterates in key order, which is what makes the files reproducible
+    for (map<pair<string, string>, MatchupStats*>::const_iterator p = m_entries.begin(); p != m_entries.end(); p++){
+        const MatchupStats& e = *p->second;
+        putString(out, p->first.first);
+        putString(out, p->first.second);
+        writeLE(out, e.games, 8);
+        writeLE(out, e.failed, 8);
+        writeLE(out, e.wins[0], 8);
+        writeLE(out, e.wins[1], 8);
+        e.shotsToWin[0].save(out);
+        e.shotsToWin[1].save(out);
+        e.gameLength.save(out);
+    }
+    out.close();
+    return bool(out);
+}
+
+void ShardResults::report(ostream& out) const
+{
+    out << fixed << setprecision(1);
+    for (map<pair<string, string>, MatchupStats*>::const_iterator p = m_entries.begin(); p != m_entries.end(); p++){
+        const MatchupStats& e = *p->second;
+        long long decided = e.wins[0] + e.wins[1];
+        out << p->first.first << " vs " << p->first.second << ": " << e.games << " games";
+        if (e.failed > 0)
+            out << " (" << e.failed << " couldn't be placed)";
+        out << endl;
+        if (decided == 0)
+            continue;
+        double w = double(e.wins[0]) / decided;
+        out << "  " << p->first.first << " wins " << 100 * w << "% +/- "
+            << 100 * 1.96 * sqrt(w * (1 - w) / decided) << "%" << endl;
+        out << "  game length in turns: mean " << e.gameLength.mean() << " +/- "
+            << e.gameLength.confidence95() << ", p50 " << e.gameLength.percentile(0.5) << endl;
+    }
+}
+
+// Merge tool: merge <output> <shard file>...
+/*
+int main(int argc, char* argv[]){
+    if (argc < 3){
+        cout << "usage: " << argv[0] << " output shard..." << endl;
+        return 1;
+    }
+    ShardResults all;
+    for (int k = 2; k < argc; k++)
+        if (!all.load(argv[k])){
+            cout << "Can't read " << argv[k] << endl;
+            return 1;
+        }
+    if (!all.save(argv[1])){
+        cout << "Can't write " << argv[1] << endl;
+        return 1;
+    }
+    all.report(cout);
+}
+*/
@@ -0,0 +1,47 @@
+#ifndef SHARDRESULTS_INCLUDED
+#define SHARDRESULTS_INCLUDED
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+
+class Tournament;
+struct MatchupStats;
+
+// The deterministic part of a tournament's totals (games, failures, wins,
+// shots to win, game lengths -- not move latency, which depends on the
+// machine) in a compact binary file. A big sweep can be split by game number
+// into shards, each run as its own process with Tournament::setSeed and
+// Tournament::runShard and saved to its own file; loading every shard file
+// into one ShardResults and saving it gives byte for byte the file a single
+// process running the whole range would have saved. Matchups are keyed by
+// their pair of strategy types and always written in sorted order.
+//
+// That only holds for strategies whose every random choice is drawn on the
+// game's thread and doesn't depend on timing. A "ponder-" player doesn't
+// qualify, and neither does mcts searching with more than one thread or up
+// to a deadline (time controls, see Tournament::setTimeControls); their
+// games, and so the shards, can come out differently from run to run.
+class ShardResults
+{
+  public:
+    ShardResults() {}
+    ~ShardResults();
+      // Adds a tournament's merged totals
+    void add(const Tournament& t);
+      // Adds a results file's totals; returns false if it can't be read
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+    void report(std::ostream& out) const;
+      // We prevent a ShardResults object from being copied or assigned
+    ShardResults(const ShardResults&) = delete;
+    ShardResults& operator=(const ShardResults&) = delete;
+
+  private:
+    MatchupStats& entry(const std::string& type1, const std::string& type2);
+
+    std::map<std::pair<std::string, std::string>, MatchupStats*> m_entries;
+};
+
+#endif // SHARDRESULTS_INCLUDED
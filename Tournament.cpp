@@ -0,0 +1,407 @@
+#include "Tournament.h"
+#include "Game.h"
+#include "Board.h"
+#include "Player.h"
+#include "globals.h"
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+Tournament::Tournament(Game& g)
+ : m_game(g), m_next(0), m_seeded(false), m_seed(0), m_moveTime(0), m_gameTime(0)
+{}
+
+namespace {
+
+// splitmix64: turns consecutive numbers into well mixed seeds
+unsigned long long mix(unsigned long long x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// FNV-1a
+unsigned long long hashString(const string& s, unsigned long long h)
+{
+    for (size_t k = 0; k < s.size(); k++){
+        h ^= (unsigned char)s[k];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+} // namespace
+
+Tournament::~Tournament()
+{
+    for (size_t w = 0; w < m_workers.size(); w++){
+        for (size_t m = 0; m < m_workers[w]->stats.size(); m++)
+            delete m_workers[w]->stats[m];
+        delete m_workers[w];
+    }
+}
+
+void Tournament::addMatchup(const string& type1, const string& type2)
+{
+    Matchup m;
+    m.type[0] = type1;
+    m.type[1] = type2;
+    // Distinct names so a strategy playing itself gets two players out of the pool
+    m.name[0] = type1 + " #1";
+    m.name[1] = type2 + " #2";
+    m.played = 0;
+    m.key = hashString(type2, hashString("/", hashString(type1, 0xcbf29ce484222325ULL)));
+    lock_guard<mutex> lock(m_workersMutex);
+    m_matchups.push_back(m);
+    for (size_t w = 0; w < m_workers.size(); w++)
+        m_workers[w]->stats.push_back(new MatchupStats);
+}
+
+int Tournament::nMatchups() const
+{
+    lock_guard<mutex> lock(m_workersMutex);
+    return (int)m_matchups.size();
+}
+
+string Tournament::matchupType(int matchup, int side) const
+{
+    lock_guard<mutex> lock(m_workersMutex);
+    return m_matchups[matchup].type[side];
+}
+
+Tournament::Matchup Tournament::matchup(int m) const
+{
+    lock_guard<mutex> lock(m_workersMutex);
+    return m_matchups[m];
+}
+
+void Tournament::work(Worker& w, const vector<int>& matchups,
+                      const vector<long long>& firstGame, long long begin, long long end)
+{
+    // Everything a game needs is set up once per thread and reused for every game
+    PlayerPool pool;
+    Board b1(m_game);
+    Board b2(m_game);
+    GameResult result;
+    PlayOptions opts;
+    opts.quiet = true;
+    opts.result = &result;
+    opts.moveTime = m_moveTime;
+    opts.gameTime = m_gameTime;
+    long long n = matchups.size();
+
+    for (;;){
+        // Grab the next game; games are interleaved so every matchup makes progress together
+        long long k = m_next.fetch_add(1, memory_order_relaxed);
+        if (k >= end)
+            break;
+        long long index = k - begin;
+        int m = matchups[index % n];
+        long long gameNo = firstGame[index % n] + index / n;
+        // Odd numbered games swap who moves first
+        bool swapped = gameNo % 2 == 1;
+        const Matchup& mu = m_matchups[m];
+        MatchupStats& s = *w.stats[m];
+        if (m_seeded)
+            seedRandom((unsigned int)mix(m_seed ^ mix(mu.key ^ mix(gameNo))));
+
+        Player* side[2];
+        for (int k2 = 0; k2 < 2; k2++)
+            side[k2] = pool.acquire(mu.type[k2], mu.name[k2], m_game);
+        Player* first = swapped ? side[1] : side[0];
+        Player* second = swapped ? side[0] : side[1];
+        opts.moveLatency = &s.moveLatency;
+        m_game.play(first, second, b1, b2, opts);
+        pool.release(side[0]);
+        pool.release(side[1]);
+
+        // Single writer, so plain load/store pairs are enough
+        s.games.store(s.games.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        for (int k2 = 0; k2 < 2; k2++){
+            int seat = (k2 == 0) != swapped ? 0 : 1;
+            if (result.overruns[seat] > 0)
+                s.overruns[k2].store(s.overruns[k2].load(memory_order_relaxed) + result.overruns[seat], memory_order_relaxed);
+        }
+        if (result.winner == nullptr){
+            s.failed.store(s.failed.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            continue;
+        }
+        int winSide = result.winner == side[0] ? 0 : 1;
+        int winSeat = result.winner == first ? 0 : 1;
+        s.wins[winSide].store(s.wins[winSide].load(memory_order_relaxed) + 1, memory_order_relaxed);
+        s.shotsToWin[winSide].record(result.shots[winSeat]);
+        s.gameLength.record(result.turns);
+    }
+}
+
+void Tournament::run(long long gamesPerMatchup, int nThreads)
+{
+    vector<int> all;
+    for (int m = 0; m < nMatchups(); m++)
+        all.push_back(m);
+    run(all, gamesPerMatchup, nThreads);
+}
+
+void Tournament::run(const vector<int>& matchups, long long gamesPerMatchup, int nThreads)
+{
+    // Each matchup carries on from the game numbers it has already played
+    vector<long long> firstGame;
+    for (size_t k = 0; k < matchups.size(); k++)
+        firstGame.push_back(m_matchups[matchups[k]].played);
+    runGames(matchups, firstGame, gamesPerMatchup, nThreads);
+}
+
+void Tournament::setSeed(unsigned long long base)
+{
+    m_seeded = true;
+    m_seed = base;
+}
+
+void Tournament::setTimeControls(long long moveTime, long long gameTime)
+{
+    m_moveTime = moveTime;
+    m_gameTime = gameTime;
+}
+
+void Tournament::runShard(long long firstGame, long long nGames, int nThreads)
+{
+    vector<int> all;
+    for (int m = 0; m < nMatchups(); m++)
+        all.push_back(m);
+    runGames(all, vector<long long>(all.size(), firstGame), nGames, nThreads);
+}
+
+void Tournament::runGames(const vector<int>& matchups, const vector<long long>& firstGame,
+                          long long gamesPerMatchup, int nThreads)
+{
+    if (nThreads < 1)
+        nThreads = 1;
+    if (matchups.empty() || gamesPerMatchup < 1)
+        return;
+    // Workers (and their totals) are kept from one run to the next
+    {
+        lock_guard<mutex> lock(m_workersMutex);
+        while ((int)m_workers.size() < nThreads){
+            Worker* w = new Worker;
+            for (size_t m = 0; m < m_matchups.size(); m++)
+                w->stats.push_back(new MatchupStats);
+            m_workers.push_back(w);
+        }
+    }
+
+    long long begin = m_next.load();
+    long long end = begin + gamesPerMatchup * (long long)matchups.size();
+    vector<thread> threads;
+    for (int t = 1; t < nThreads; t++)
+        threads.push_back(thread(&Tournament::work, this, ref(*m_workers[t]), cref(matchups),
+                                 cref(firstGame), begin, end));
+    work(*m_workers[0], matchups, firstGame, begin, end);
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    m_next.store(end);
+    lock_guard<mutex> lock(m_workersMutex);
+    for (size_t k = 0; k < matchups.size(); k++){
+        long long& played = m_matchups[matchups[k]].played;
+        if (played < firstGame[k] + gamesPerMatchup)
+            played = firstGame[k] + gamesPerMatchup;
+    }
+}
+
+MatchupVerdict Tournament::verdict(int matchup, const StoppingRule& rule) const
+{
+    MatchupStats s;
+    merged(matchup, s);
+    MatchupVerdict v;
+    v.games = s.games;
+    double w = (double)s.wins[0], l = (double)s.wins[1];
+
+    if (rule.method == StoppingRule::SPRT){
+        // Log likelihood ratio of "first side wins 1/2+delta" against "first side wins 1/2-delta"
+        double p1 = 0.5 + rule.delta, p2 = 0.5 - rule.delta;
+        v.statistic = w * log(p1 / p2) + l * log((1 - p1) / (1 - p2));
+        double upper = log((1 - rule.beta) / rule.alpha);
+        double lower = log(rule.beta / (1 - rule.alpha));
+        if (v.statistic >= upper)
+            v.outcome = MatchupVerdict::FIRST_BETTER;
+        else if (v.statistic <= lower)
+            v.outcome = MatchupVerdict::SECOND_BETTER;
+        return v;
+    }
+
+    if (s.games < rule.minGames)
+        return v;
+    if (rule.metric == StoppingRule::WIN_RATE){
+        double n = w + l;
+        if (n == 0)
+            return v;
+        double p = w / n;
+        double se = sqrt(p * (1 - p) / n);
+        v.statistic = se > 0 ? (p - 0.5) / se : (p - 0.5) * numeric_limits<double>::infinity();
+    }
+    else {
+        // Difference of the mean shots to win, in standard errors; fewer shots is better
+        const Histogram& a = s.shotsToWin[0];
+        const Histogram& b = s.shotsToWin[1];
+        if (a.count() < 2 || b.count() < 2)
+            return v;
+        double se = sqrt(a.stddev() * a.stddev() / a.count() + b.stddev() * b.stddev() / b.count());
+        double diff = b.mean() - a.mean();
+        v.statistic = se > 0 ? diff / se : diff * numeric_limits<double>::infinity();
+    }
+    if (v.statistic > rule.z)
+        v.outcome = MatchupVerdict::FIRST_BETTER;
+    else if (v.statistic < -rule.z)
+        v.outcome = MatchupVerdict::SECOND_BETTER;
+    return v;
+}
+
+MatchupVerdict Tournament::runUntilDecided(int matchup, const StoppingRule& rule,
+                                           long long batch, long long maxGames, int nThreads)
+{
+    vector<int> only(1, matchup);
+    MatchupVerdict v = verdict(matchup, rule);
+    while (v.outcome == MatchupVerdict::UNDECIDED && v.games < maxGames){
+        long long n = batch;
+        if (v.games + n > maxGames)
+            n = maxGames - v.games;
+        run(only, n, nThreads);
+        v = verdict(matchup, rule);
+    }
+    return v;
+}
+
+int Tournament::findMatchup(const string& type1, const string& type2) const
+{
+    for (int m = 0; m < nMatchups(); m++)
+        if (m_matchups[m].type[0] == type1 && m_matchups[m].type[1] == type2)
+            return m;
+    return -1;
+}
+
+void Tournament::runRoundRobin(const StoppingRule& rule, long long batch,
+                               long long maxGamesPerPair, long long budget, int nThreads)
+{
+    // Every pairing of two different computer strategies
+    vector<string> all = playerTypes();
+    vector<string> types;
+    for (size_t k = 0; k < all.size(); k++){
+        Player* p = createPlayer(all[k], "probe", m_game);
+        if (p != nullptr && !p->isHuman())
+            types.push_back(all[k]);
+        delete p;
+    }
+    vector<int> pairs;
+    for (size_t i = 0; i < types.size(); i++)
+        for (size_t j = i + 1; j < types.size(); j++){
+            int m = findMatchup(types[i], types[j]);
+            if (m == -1){
+                addMatchup(types[i], types[j]);
+                m = nMatchups() - 1;
+            }
+            pairs.push_back(m);
+        }
+
+    long long spent = 0;
+    while (spent < budget){
+        // Pick the undecided pairing that is hardest to call: the one whose
+        // statistic is furthest from a stopping boundary, unplayed ones first
+        int best = -1;
+        double bestScore = -1;
+        for (size_t k = 0; k < pairs.size(); k++){
+            MatchupVerdict v = verdict(pairs[k], rule);
+            if (v.outcome != MatchupVerdict::UNDECIDED || v.games >= maxGamesPerPair)
+                continue;
+            double score;
+            if (v.games == 0)
+                score = numeric_limits<double>::infinity();
+            else if (rule.method == StoppingRule::SPRT){
+                double upper = log((1 - rule.beta) / rule.alpha);
+                double lower = log(rule.beta / (1 - rule.alpha));
+                score = min(upper - v.statistic, v.statistic - lower);
+            }
+            else
+                score = rule.z - fabs(v.statistic);
+            if (score > bestScore){
+                bestScore = score;
+                best = pairs[k];
+            }
+        }
+        if (best == -1)
+            break;
+        long long n = min(batch, budget - spent);
+        run(vector<int>(1, best), n, nThreads);
+        spent += n;
+    }
+}
+
+void Tournament::merged(int matchup, MatchupStats& total) const
+{
+    lock_guard<mutex> lock(m_workersMutex);
+    for (size_t w = 0; w < m_workers.size(); w++){
+        const MatchupStats& s = *m_workers[w]->stats[matchup];
+        total.games += s.games.load(memory_order_relaxed);
+        total.failed += s.failed.load(memory_order_relaxed);
+        for (int k = 0; k < 2; k++){
+            total.wins[k] += s.wins[k].load(memory_order_relaxed);
+            total.overruns[k] += s.overruns[k].load(memory_order_relaxed);
+            total.shotsToWin[k].merge(s.shotsToWin[k]);
+        }
+        total.gameLength.merge(s.gameLength);
+        total.moveLatency.merge(s.moveLatency);
+    }
+}
+
+long long Tournament::gamesCompleted() const
+{
+    lock_guard<mutex> lock(m_workersMutex);
+    long long n = 0;
+    for (size_t w = 0; w < m_workers.size(); w++)
+        for (size_t m = 0; m < m_workers[w]->stats.size(); m++)
+            n += m_workers[w]->stats[m]->games.load(memory_order_relaxed);
+    return n;
+}
+
+void Tournament::report(ostream& out) const
+{
+    out << fixed << setprecision(1);
+    for (int m = 0; m < nMatchups(); m++){
+        Matchup mu = matchup(m);
+        MatchupStats s;
+        merged(m, s);
+        long long decided = s.wins[0] + s.wins[1];
+        out << mu.type[0] << " vs " << mu.type[1] << ": "
+            << s.games << " games";
+        if (s.failed > 0)
+            out << " (" << s.failed << " couldn't be placed)";
+        out << endl;
+        if (decided == 0)
+            continue;
+        // Win rate with its 95% confidence interval (normal approximation)
+        double p = double(s.wins[0]) / decided;
+        double half = 1.96 * sqrt(p * (1 - p) / decided);
+        out << "  " << mu.name[0] << " wins " << 100 * p << "% +/- " << 100 * half << "%" << endl;
+        for (int k = 0; k < 2; k++){
+            const Histogram& h = s.shotsToWin[k];
+            if (h.count() == 0)
+                continue;
+            out << "  shots to win for " << mu.name[k] << ": mean " << h.mean()
+                << " +/- " << h.confidence95() << ", p50 " << h.percentile(0.5)
+                << ", p90 " << h.percentile(0.9) << ", p99 " << h.percentile(0.99) << endl;
+        }
+        out << "  game length in turns: mean " << s.gameLength.mean()
+            << " +/- " << s.gameLength.confidence95() << ", p50 " << s.gameLength.percentile(0.5)
+            << ", p99 " << s.gameLength.percentile(0.99) << endl;
+        out << "  move latency in ns: mean " << s.moveLatency.mean()
+            << ", p50 " << s.moveLatency.percentile(0.5) << ", p99 " << s.moveLatency.percentile(0.99)
+            << ", max " << s.moveLatency.max() << endl;
+        if (s.overruns[0] + s.overruns[1] > 0)
+            out << "  shots over the time allowed: " << mu.name[0] << " " << s.overruns[0]
+                << ", " << mu.name[1] << " " << s.overruns[1] << endl;
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef TOURNAMENT_INCLUDED
+#define TOURNAMENT_INCLUDED
+
+#include "Histogram.h"
+#include <atomic>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Game;
+
+  // When a sequential matchup may stop playing
+struct StoppingRule
+{
+    enum Method {
+        SPRT,           // Wald's sequential probability ratio test on the win rate
+        CONFIDENCE      // stop once the confidence interval clears the tie line
+    };
+    enum Metric {
+        WIN_RATE,       // is one side's win rate above 1/2?
+        SHOTS_TO_WIN    // does one side need fewer shots to win? (CONFIDENCE only)
+    };
+    StoppingRule()
+     : method(SPRT), metric(WIN_RATE), delta(0.05), alpha(0.05), beta(0.05),
+       z(2.576), minGames(100)
+    {}
+    Method method;
+    Metric metric;
+    double delta;         // SPRT: tell win rate 1/2+delta from 1/2-delta
+    double alpha, beta;   // SPRT: error rates
+    double z;             // CONFIDENCE: width of the interval in standard errors
+    long long minGames;   // CONFIDENCE: never stop before this many games
+};
+
+struct MatchupVerdict
+{
+    enum Outcome { UNDECIDED, FIRST_BETTER, SECOND_BETTER };
+    MatchupVerdict() : outcome(UNDECIDED), games(0), statistic(0) {}
+    Outcome outcome;
+    long long games;
+    double statistic;     // SPRT: log likelihood ratio; CONFIDENCE: difference in standard errors
+};
+
+  // Running totals for one pairing of strategies. Every worker thread keeps
+  // its own copy and is the only one to write it, so nothing here is shared
+  // between workers while games are being played. Side 0 is the pairing's
+  // first strategy, side 1 its second, whichever of them happened to move first.
+struct MatchupStats
+{
+    MatchupStats() : games(0), failed(0) { wins[0] = wins[1] = 0; overruns[0] = overruns[1] = 0; }
+    std::atomic<long long> games;
+    std::atomic<long long> failed;    // games where a fleet couldn't be placed
+    std::atomic<long long> wins[2];
+    std::atomic<long long> overruns[2];   // shots over the time allowed, per side
+    Histogram shotsToWin[2];          // shots fired by the winner, per winning side
+    Histogram gameLength;             // turns taken by both players together
+    Histogram moveLatency;            // nanoseconds per recommendAttack, both sides
+};
+
+  // Plays many quiet games between computer strategies on several threads
+  // and reports per-pairing statistics. The per-thread totals are merged only
+  // when a report is asked for, so adding threads adds no contention. Reports
+  // (and merged()) may be taken from another thread while run() or
+  // runRoundRobin() is going, even as the round robin adds its pairings;
+  // addMatchup may not be called while another thread is in run().
+class Tournament
+{
+  public:
+    Tournament(Game& g);
+    ~Tournament();
+      // Strategies are createPlayer type names; the same type may play itself
+    void addMatchup(const std::string& type1, const std::string& type2);
+    int nMatchups() const;
+      // A copy, since the matchups may move when one is added
+    std::string matchupType(int matchup, int side) const;
+      // Plays gamesPerMatchup more games of every matchup, alternating which
+      // side moves first, and returns when they are all done
+    void run(long long gamesPerMatchup, int nThreads);
+      // The same for only the listed matchups
+    void run(const std::vector<int>& matchups, long long gamesPerMatchup, int nThreads);
+      // From now on every game is seeded from base, its matchup's types and
+      // its game number, so its outcome doesn't depend on which thread or
+      // process played it -- as long as both strategies draw all their random
+      // numbers on the game's thread and don't look at the clock. Pondering
+      // players, mcts with more than one thread, and anything that searches
+      // to a deadline don't; see ShardResults.h.
+    void setSeed(unsigned long long base);
+      // Plays every game from now on under these time controls, in
+      // nanoseconds (see PlayOptions::moveTime)
+    void setTimeControls(long long moveTime, long long gameTime);
+      // Plays game numbers firstGame .. firstGame+nGames-1 of every matchup.
+      // With a seed set, shards covering disjoint game ranges (possibly in
+      // different processes) add up to exactly what one run of the whole range
+      // would give; see ShardResults.h.
+    void runShard(long long firstGame, long long nGames, int nThreads);
+      // Where the statistics of a matchup stand under a stopping rule
+    MatchupVerdict verdict(int matchup, const StoppingRule& rule) const;
+      // Plays a matchup batch by batch until the rule decides it or maxGames
+      // have been played
+    MatchupVerdict runUntilDecided(int matchup, const StoppingRule& rule,
+                                   long long batch, long long maxGames, int nThreads);
+      // Round robin of every computer strategy createPlayer knows. Each batch
+      // goes to the undecided pairing whose result is least clear, so close
+      // pairings get the games and lopsided ones stop early. Stops when every
+      // pairing is decided, has had maxGamesPerPair, or budget games are spent.
+    void runRoundRobin(const StoppingRule& rule, long long batch,
+                       long long maxGamesPerPair, long long budget, int nThreads);
+      // Adds up every worker's totals for one matchup into total (which
+      // should start out empty)
+    void merged(int matchup, MatchupStats& total) const;
+      // Games finished so far, over every matchup and run
+    long long gamesCompleted() const;
+    void report(std::ostream& out) const;
+      // We prevent a Tournament object from being copied or assigned
+    Tournament(const Tournament&) = delete;
+    Tournament& operator=(const Tournament&) = delete;
+
+  private:
+    struct Matchup
+    {
+        std::string type[2];
+        std::string name[2];
+        long long played;     // game numbers handed out so far
+        unsigned long long key;   // hash of the types, for seeding
+    };
+    struct Worker
+    {
+        std::vector<MatchupStats*> stats;   // one per matchup
+    };
+
+    void work(Worker& w, const std::vector<int>& matchups,
+              const std::vector<long long>& firstGame, long long begin, long long end);
+    void runGames(const std::vector<int>& matchups, const std::vector<long long>& firstGame,
+                  long long gamesPerMatchup, int nThreads);
+    int findMatchup(const std::string& type1, const std::string& type2) const;
+      // A copy of a matchup, for threads other than the one adding them
+    Matchup matchup(int m) const;
+
+    Game& m_game;
+    std::vector<Matchup> m_matchups;
+    std::vector<Worker*> m_workers;
+    // Guards changes to m_workers and m_matchups against readers on other
+    // threads; the game threads themselves never take it, since matchups are
+    // only added between runs
+    mutable std::mutex m_workersMutex;
+    std::atomic<long long> m_next;
+    bool m_seeded;
+    unsigned long long m_seed;
+    long long m_moveTime;
+    long long m_gameTime;
+};
+
+#endif // TOURNAMENT_INCLUDED
@@ -0,0 +1,163 @@
+#include "Trace.h"
+
+#ifdef BATTLESHIP_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+namespace {
+
+const int EVENTS_PER_THREAD = 1 << 16;
+
+struct TraceEvent
+{
+    const char* name;
+    const char* category;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Each thread appends only to its own buffer, so recording never waits on
+// another thread. The buffer publishes its length with a release store, which
+// lets the exporter read the finished events without stopping anybody.
+struct TraceBuffer
+{
+    TraceEvent events[EVENTS_PER_THREAD];
+    atomic<int> size;
+    atomic<long long> dropped;
+    atomic<bool> inUse;     // by a live thread
+    int tid;
+    TraceBuffer* next;
+};
+
+// All the buffers ever created, pushed with a compare-and-swap. Buffers are
+// never freed so the exporter can walk the list at any time. Instead, when a
+// thread exits its buffer is handed on to the next new thread, which carries
+// on after the events already in it; so a pool that keeps replacing its
+// threads needs only as many buffers as it ever has threads at once.
+atomic<TraceBuffer*> g_buffers(nullptr);
+atomic<int> g_nextTid(1);
+
+// Gives the thread's buffer back when the thread exits
+struct BufferLease
+{
+    BufferLease() : buffer(nullptr) {}
+    ~BufferLease()
+    {
+        if (buffer != nullptr)
+            buffer->inUse.store(false, memory_order_release);
+    }
+    TraceBuffer* buffer;
+};
+
+TraceBuffer* threadBuffer()
+{
+    static thread_local BufferLease t_lease;
+    if (t_lease.buffer == nullptr){
+        // One a finished thread left behind, if there is one
+        for (TraceBuffer* b = g_buffers.load(memory_order_acquire); b != nullptr; b = b->next){
+            bool idle = false;
+            if (b->inUse.compare_exchange_strong(idle, true, memory_order_acquire, memory_order_relaxed)){
+                t_lease.buffer = b;
+                return b;
+            }
+        }
+        TraceBuffer* b = new TraceBuffer;
+        b->size.store(0, memory_order_relaxed);
+        b->dropped.store(0, memory_order_relaxed);
+        b->inUse.store(true, memory_order_relaxed);
+        b->tid = g_nextTid.fetch_add(1);
+        b->next = g_buffers.load(memory_order_relaxed);
+        while (!g_buffers.compare_exchange_weak(b->next, b, memory_order_release, memory_order_relaxed))
+            ;
+        t_lease.buffer = b;
+    }
+    return t_lease.buffer;
+}
+
+void writeString(ostream& out, const char* s)
+{
+    out << '"';
+    for (; *s != '\0'; s++){
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+} // namespace
+
+uint64_t traceNow()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceRecord(const char* name, const char* category, uint64_t start, uint64_t end)
+{
+    TraceBuffer* b = threadBuffer();
+    int n = b->size.load(memory_order_relaxed);
+    // When the buffer is full we drop the event rather than stall the game
+    if (n == EVENTS_PER_THREAD){
+        b->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    TraceEvent& e = b->events[n];
+    e.name = name;
+    e.category = category;
+    e.start = start;
+    e.end = end;
+    b->size.store(n + 1, memory_order_release);
+}
+
+bool traceWriteChromeJson(const char* path)
+{
+    ofstream out(path);
+    if (!out)
+        return false;
+
+    out << fixed << setprecision(3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (TraceBuffer* b = g_buffers.load(memory_order_acquire); b != nullptr; b = b->next){
+        int n = b->size.load(memory_order_acquire);
+        for (int k = 0; k < n; k++){
+            const TraceEvent& e = b->events[k];
+            if (!first)
+                out << ",\n";
+            first = false;
+            // Complete ("X") events with microsecond timestamps
+            out << "{\"name\":";
+            writeString(out, e.name);
+            out << ",\"cat\":";
+            writeString(out, e.category);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"ts\":" << e.start / 1000.0
+                << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+        }
+        long long dropped = b->dropped.load(memory_order_relaxed);
+        if (dropped > 0){
+            if (!first)
+                out << ",\n";
+            first = false;
+            out << "{\"name\":\"dropped events\",\"ph\":\"C\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"ts\":0,\"args\":{\"dropped\":" << dropped << "}}";
+        }
+    }
+    out << "]}\n";
+    return bool(out);
+}
+
+#else
+
+bool traceWriteChromeJson(const char* /* path */)
+{
+    return false;
+}
+
+#endif // BATTLESHIP_TRACE
@@ -0,0 +1,53 @@
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+// Compile-time switchable tracing of the game pipeline. Build with
+// BATTLESHIP_TRACE defined and every TRACE_SCOPE records how long the
+// enclosing block took into a buffer owned by the calling thread; later
+// traceWriteChromeJson writes all threads' events in the Chrome trace format
+// (load it in chrome://tracing or Perfetto). Without BATTLESHIP_TRACE the
+// macro expands to nothing at all.
+//
+// name and category must be string literals (or otherwise outlive the
+// export), since only the pointers are stored.
+
+#ifdef BATTLESHIP_TRACE
+
+#include <cstdint>
+
+uint64_t traceNow();
+void traceRecord(const char* name, const char* category, uint64_t start, uint64_t end);
+
+class TraceScope
+{
+  public:
+    TraceScope(const char* name, const char* category)
+     : m_name(name), m_category(category), m_start(traceNow())
+    {}
+    ~TraceScope() { traceRecord(m_name, m_category, m_start, traceNow()); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* m_name;
+    const char* m_category;
+    uint64_t m_start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name, category) \
+    TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, category)
+
+#else
+
+#define TRACE_SCOPE(name, category) ((void)0)
+
+#endif // BATTLESHIP_TRACE
+
+  // Writes every event recorded so far; returns false if tracing is compiled
+  // out or the file can't be written. Threads may keep tracing meanwhile;
+  // events they finish during the export may or may not make it in.
+bool traceWriteChromeJson(const char* path);
+
+#endif // TRACE_INCLUDED
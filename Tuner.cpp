@@ -0,0 +1,140 @@
+#include "Tuner.h"
+#include "Tournament.h"
+#include "Game.h"
+#include "globals.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// The usual SPSA schedules: steps shrink as 1/k^0.602 after a settling-in
+// period, perturbations as 1/k^0.101
+const double RATE_DECAY = 0.602;
+const double PERTURBATION_DECAY = 0.101;
+const double SETTLING = 10;
+
+double winRate(const Tournament& t, int matchup)
+{
+    MatchupStats s;
+    t.merged(matchup, s);
+    long long played = s.games.load() - s.failed.load();
+    return played == 0 ? 0 : (double)s.wins[0].load() / played;
+}
+
+} // namespace
+
+Tuner::Tuner(Game& g, const string& type, const string& opponent, const StrategyParams& start)
+ : m_game(g), m_type(type), m_opponent(opponent), m_current(start), m_best(start),
+   m_bestScore(-1), m_steps(0)
+{}
+
+bool Tuner::addKnob(const string& name, double lo, double hi)
+{
+    StrategyParams probe;
+    if (!probe.set(name, lo) || hi <= lo)
+        return false;
+    Knob k;
+    k.name = name;
+    k.lo = lo;
+    k.hi = hi;
+    k.x = min(max((m_current.get(name) - lo) / (hi - lo), 0.0), 1.0);
+    m_knobs.push_back(k);
+    return true;
+}
+
+StrategyParams Tuner::at(const vector<double>& x) const
+{
+    StrategyParams p = m_current;
+    for (size_t i = 0; i < m_knobs.size(); i++){
+        double v = min(max(x[i], 0.0), 1.0);
+        p.set(m_knobs[i].name, m_knobs[i].lo + v * (m_knobs[i].hi - m_knobs[i].lo));
+    }
+    p.normalize();
+    return p;
+}
+
+void Tuner::run(int steps, const Settings& s, ostream& log)
+{
+    size_t n = m_knobs.size();
+    if (n == 0)
+        return;
+    vector<double> x(n);
+    for (size_t i = 0; i < n; i++)
+        x[i] = m_knobs[i].x;
+
+    for (int step = 0; step < steps; step++, m_steps++){
+        double k = m_steps + 1;
+        double a = s.rate / pow(k + SETTLING, RATE_DECAY);
+        double c = s.perturbation / pow(k, PERTURBATION_DECAY);
+
+        // The point itself, then every pair, all in one batch
+        Tournament t(m_game);
+        t.setSeed(s.seed + m_steps);
+        m_current = at(x);
+        t.addMatchup(m_type + ":" + m_current.str(), m_opponent);
+        vector<vector<double> > delta(s.pairs, vector<double>(n));
+        for (int j = 0; j < s.pairs; j++){
+            vector<double> plus(x), minus(x);
+            for (size_t i = 0; i < n; i++){
+                delta[j][i] = randInt(2) == 0 ? -1 : 1;
+                plus[i] += c * delta[j][i];
+                minus[i] -= c * delta[j][i];
+            }
+            t.addMatchup(m_type + ":" + at(plus).str(), m_opponent);
+            t.addMatchup(m_type + ":" + at(minus).str(), m_opponent);
+        }
+        t.run(s.games, s.threads);
+
+        double score = winRate(t, 0);
+        ios::fmtflags flags = log.flags();
+        streamsize precision = log.precision();
+        if (score > m_bestScore){
+            m_bestScore = score;
+            m_best = m_current;
+        }
+        log << "step " << m_steps << ": " << m_current.str() << " won "
+            << fixed << setprecision(3) << score << "; pairs";
+        vector<double> slope(n, 0);
+        for (int j = 0; j < s.pairs; j++){
+            double up = winRate(t, 1 + 2 * j);
+            double down = winRate(t, 2 + 2 * j);
+            log << " " << up << "/" << down;
+            // 1/delta is delta when it's +-1
+            for (size_t i = 0; i < n; i++)
+                slope[i] += (up - down) / (2 * c) * delta[j][i] / s.pairs;
+        }
+        for (size_t i = 0; i < n; i++){
+            x[i] = min(max(x[i] + a * slope[i], 0.0), 1.0);
+            m_knobs[i].x = x[i];
+        }
+        m_current = at(x);
+        log << "; best " << m_best.str() << " at " << m_bestScore << endl;
+        log.flags(flags);
+        log.precision(precision);
+    }
+}
+
+// Tuning good's hunt against the stock good player, then the result as a
+// type createPlayer understands
+/*
+#include <fstream>
+int main(){
+    Game g(10,10);
+    g.addShip(5, 'a', "aircraft carrier"); g.addShip(4, 'b', "battleship");
+    g.addShip(3, 'd', "destroyer"); g.addShip(3, 's', "submarine"); g.addShip(2, 'p', "patrol boat");
+    Tuner tuner(g, "good", "good");
+    tuner.addKnob("densityExponent", -1, 4);
+    tuner.addKnob("huntSpacing", 1, 4);
+    Tuner::Settings s;
+    s.games = 400;
+    s.threads = 4;
+    ofstream log("tuning.log");
+    tuner.run(30, s, log);
+    ofstream("best.txt") << "good:" << tuner.best().str() << endl;
+    cout << "best: good:" << tuner.best().str() << " won " << tuner.bestScore() << endl;
+}
+*/
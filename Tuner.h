@@ -0,0 +1,75 @@
+#ifndef TUNER_INCLUDED
+#define TUNER_INCLUDED
+
+#include "Player.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Game;
+
+// Tunes a strategy's StrategyParams by playing it against an opponent, with
+// SPSA (simultaneous perturbation stochastic approximation). Each step moves
+// every knob at once a random +c or -c of its range away from where it is,
+// and then the opposite way. The difference in win rate between the two
+// says which way is uphill for all of them together. Several such pairs
+// are drawn per step, and their games go to the threads as one Tournament
+// batch, along with games for the point itself so the best point can be
+// kept track of.
+//
+// Knobs that are whole numbers are rounded when played, so give them ranges
+// wide enough that c of the range moves them.
+
+class Tuner
+{
+  public:
+    struct Settings
+    {
+        Settings()
+         : pairs(4), games(200), perturbation(0.1), rate(0.5), threads(1), seed(1)
+        {}
+        int pairs;               // +c/-c pairs per step
+        long long games;         // per point tried
+        double perturbation;     // c, as a fraction of each knob's range; shrinks slowly
+        double rate;             // how far a step goes per unit of win rate slope; shrinks
+        int threads;
+        unsigned long long seed; // for the Tournament's games (see Tournament::setSeed)
+    };
+
+      // type is a createPlayer type that takes StrategyParams; opponent is any
+      // createPlayer type
+    Tuner(Game& g, const std::string& type, const std::string& opponent,
+          const StrategyParams& start = StrategyParams());
+      // Tunes the named parameter between lo and hi
+    bool addKnob(const std::string& name, double lo, double hi);
+      // Takes steps more steps, writing a line about each to log
+    void run(int steps, const Settings& s, std::ostream& log);
+
+    const StrategyParams& current() const { return m_current; }
+      // The point with the best win rate so far, and that win rate; with
+      // Settings::games games behind it, it's only as sure as that allows
+    const StrategyParams& best() const { return m_best; }
+    double bestScore() const { return m_bestScore; }
+    int stepsTaken() const { return m_steps; }
+
+  private:
+    struct Knob
+    {
+        std::string name;
+        double lo, hi;
+        double x;      // where it is, from 0 (lo) to 1 (hi)
+    };
+
+    StrategyParams at(const std::vector<double>& x) const;
+
+    Game& m_game;
+    std::string m_type;
+    std::string m_opponent;
+    std::vector<Knob> m_knobs;
+    StrategyParams m_current;
+    StrategyParams m_best;
+    double m_bestScore;
+    int m_steps;
+};
+
+#endif // TUNER_INCLUDED
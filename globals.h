@@ -5,6 +5,8 @@
 
 const int MAXROWS = 10;
 const int MAXCOLS = 10;
+  // Every ship covers at least one cell, so this bounds Game::nShips()
+const int MAXSHIPS = MAXROWS * MAXCOLS;
 
 enum Direction {
     HORIZONTAL, VERTICAL
@@ -19,15 +21,28 @@ class Point
     int c;
 };
 
+  // The calling thread's random number generator (each thread has its own,
+  // so games can run in parallel)
+inline std::mt19937& randomGenerator()
+{
+    static thread_local std::random_device rd;
+    static thread_local std::mt19937 generator(rd());
+    return generator;
+}
+
+  // Make the calling thread's random numbers repeatable from here on
+inline void seedRandom(unsigned int seed)
+{
+    randomGenerator().seed(seed);
+}
+
   // Return a uniformly distributed random int from 0 to limit-1
 inline int randInt(int limit)
 {
-    static std::random_device rd;
-    static std::mt19937 generator(rd());
     if (limit < 1)
         limit = 1;
     std::uniform_int_distribution<> distro(0, limit-1);
-    return distro(generator);
+    return distro(randomGenerator());
 }
 
 #endif // GLOBALS_INCLUDED